@@ -2,20 +2,45 @@
 ; This loads the kernel from disk and jumps to it
 
 [BITS 16]
-[ORG 0x7c00]
+[ORG 0x0600]
 
-KERNEL_OFFSET equ 0x1000  ; Load kernel at 1MB mark
+KERNEL_OFFSET equ 0x1000  ; Load kernel at 4KB mark
+BOOT_RELOC    equ 0x0600  ; Bootloader moves itself here so the kernel can extend past 0x7C00
 
-start:
-    ; Save boot drive (BIOS passes it in DL)
-    mov [BOOT_DRIVE], dl
+; BIOS memory map for the kernel: entry count (dword), then 24-byte E820
+; entries. Clear of the kernel image and both stacks; see kernel/pmm.h.
+E820_MAP      equ 0x80000
+E820_MAX      equ 64
+
+; Number of kernel sectors to load (the Makefile passes -DKERNEL_SECTORS and
+; checks that kernel.bin fits)
+%ifndef KERNEL_SECTORS
+%define KERNEL_SECTORS 256
+%endif
 
-    ; Set up segments
+start:
+    ; Relocate from 0x7C00 to BOOT_RELOC. Everything up to the far jump
+    ; is position-independent.
+    cli
     xor ax, ax
     mov ds, ax
     mov es, ax
+    mov si, 0x7c00
+    mov di, BOOT_RELOC
+    mov cx, 256
+    cld
+    rep movsw
+    jmp 0:relocated
+
+relocated:
+    ; Save boot drive (BIOS passes it in DL)
+    mov [BOOT_DRIVE], dl
+
+    ; Set up stack at 0x9F000, clear of the kernel load area
+    mov ax, 0x9000
     mov ss, ax
-    mov sp, 0x7c00  ; Stack grows downward from bootloader
+    mov sp, 0xF000
+    sti
 
     ; Print loading message
     mov si, msg_loading
@@ -24,6 +49,9 @@ start:
     ; Load kernel from disk
     call load_kernel
 
+    ; Ask the BIOS where the RAM is
+    call detect_memory
+
     ; Print success message
     mov si, msg_loaded
     call print_string
@@ -49,50 +77,86 @@ print_string:
     ret
 
 ; Load kernel from disk
-; Floppy: 18 sectors/track, 2 heads. Boot sector is track 0, head 0, sector 1.
-; Kernel starts at sector 2. First read: sectors 2-18 (17 sectors) from head 0.
-; Second read: sectors 1-18 (18 sectors) from head 1.
-; Third read: sectors 1-18 (18 sectors) from cylinder 1, head 0.
-; Total: 17 + 18 + 18 = 53 sectors = 27136 bytes (enough for kernel)
+; Floppy: 18 sectors/track, 2 heads. Boot sector is CHS 0/0/1, kernel starts
+; at CHS 0/0/2. Sectors are read one at a time, advancing ES by 512 bytes, so
+; the kernel can span any number of tracks and 64KB segments.
 load_kernel:
     pusha
-    mov dl, [BOOT_DRIVE]
+    push es
 
-    ; Read 1: 17 sectors from CHS 0/0/2
-    mov bx, KERNEL_OFFSET
-    mov ah, 0x02
-    mov al, 17             ; 17 sectors (2 through 18)
+    mov ax, KERNEL_OFFSET >> 4
+    mov es, ax
+    xor bx, bx
     mov ch, 0              ; cylinder 0
     mov cl, 2              ; start at sector 2
     mov dh, 0              ; head 0
-    int 0x13
-    jc disk_error
+    mov di, KERNEL_SECTORS
 
-    ; Read 2: 18 sectors from CHS 0/1/1
-    add bx, 17 * 512
+.next_sector:
     mov ah, 0x02
-    mov al, 18
-    mov ch, 0              ; cylinder 0
-    mov cl, 1              ; sector 1
-    mov dh, 1              ; head 1
+    mov al, 1
     mov dl, [BOOT_DRIVE]
     int 0x13
     jc disk_error
 
-    ; Read 3: 18 sectors from CHS 1/0/1
-    add bx, 18 * 512
-    mov ah, 0x02
-    mov al, 18
-    mov ch, 1              ; cylinder 1
-    mov cl, 1              ; sector 1
-    mov dh, 0              ; head 0
-    mov dl, [BOOT_DRIVE]
-    int 0x13
-    jc disk_error
+    ; Advance destination by one sector
+    mov ax, es
+    add ax, 512 >> 4
+    mov es, ax
 
+    ; Advance CHS: sector 1-18, then head 0-1, then cylinder
+    inc cl
+    cmp cl, 19
+    jb .chs_done
+    mov cl, 1
+    inc dh
+    cmp dh, 2
+    jb .chs_done
+    mov dh, 0
+    inc ch
+.chs_done:
+    dec di
+    jnz .next_sector
+
+    pop es
     popa
     ret
 
+; Collect the INT 15h E820 memory map at E820_MAP. The count stays 0 if
+; the BIOS does not support it; the kernel then assumes 16MB.
+detect_memory:
+    pushad
+    push es
+
+    mov ax, E820_MAP >> 4
+    mov es, ax
+    mov di, 4
+    xor ebx, ebx            ; continuation value, 0 = first entry
+    xor bp, bp              ; entries stored
+
+.next_entry:
+    mov eax, 0xE820
+    mov edx, 0x534D4150     ; 'SMAP'
+    mov ecx, 24
+    mov dword [es:di + 20], 1   ; valid if the BIOS only fills 20 bytes
+    int 0x15
+    jc .done
+    cmp eax, 0x534D4150
+    jne .done
+    inc bp
+    add di, 24
+    test ebx, ebx           ; 0 = that was the last entry
+    jz .done
+    cmp bp, E820_MAX
+    jb .next_entry
+
+.done:
+    mov [es:0], bp
+    mov word [es:2], 0
+    pop es
+    popad
+    ret
+
 disk_error:
     mov si, msg_disk_error
     call print_string
@@ -125,7 +189,8 @@ init_pm:
     mov ebp, 0x90000
     mov esp, ebp
 
-    ; Jump to kernel
+    ; Jump to kernel, memory map in EBX
+    mov ebx, E820_MAP
     call KERNEL_OFFSET
 
     ; Hang if kernel returns
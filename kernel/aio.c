@@ -0,0 +1,134 @@
+#include "aio.h"
+#include "file.h"
+#include "paging.h"
+#include "process.h"
+#include "heap.h"
+
+#define RING_MASK (AIO_RING_ENTRIES - 1)
+
+/* A process's registered ring, and requests taken off its SQ but not yet run */
+struct aio_ctx {
+    aio_ring_t *ring;
+    aio_sqe_t pending[AIO_RING_ENTRIES];
+    uint32_t pending_head;
+    uint32_t pending_count;
+};
+
+static struct aio_ctx *current_ctx(void) {
+    process_t *cur = process_get_current();
+    return cur ? cur->aio : 0;
+}
+
+/* Run one request and post its completion */
+static void aio_run(aio_ring_t *ring, aio_sqe_t *sqe) {
+    int result;
+
+    switch (sqe->opcode) {
+        case AIO_OP_NOP:
+            result = 0;
+            break;
+        case AIO_OP_OPEN:
+            result = paging_user_string((const char *)sqe->addr) ?
+                     file_open((const char *)sqe->addr, sqe->len) : -1;
+            break;
+        case AIO_OP_READ:
+            result = paging_user_range(sqe->addr, sqe->len) ?
+                     file_read(sqe->fd, (uint8_t *)sqe->addr, sqe->len) : -1;
+            break;
+        case AIO_OP_WRITE:
+            result = paging_user_range(sqe->addr, sqe->len) ?
+                     file_write(sqe->fd, (const uint8_t *)sqe->addr, sqe->len) : -1;
+            break;
+        case AIO_OP_CLOSE:
+            result = file_close(sqe->fd);
+            break;
+        default:
+            result = -1;
+            break;
+    }
+
+    aio_cqe_t *cqe = &ring->cq[ring->cq_tail & RING_MASK];
+    cqe->user_data = sqe->user_data;
+    cqe->result = result;
+
+    /* Publish the entry before the tail the program polls */
+    __asm__ volatile("" ::: "memory");
+    ring->cq_tail++;
+}
+
+int aio_setup(aio_ring_t *new_ring) {
+    process_t *cur = process_get_current();
+    if (!cur) {
+        return -1;
+    }
+    if (!new_ring) {
+        aio_release(cur->aio);
+        cur->aio = 0;
+        return 0;
+    }
+
+    if (!paging_user_range((uint32_t)new_ring, sizeof(aio_ring_t))) {
+        return -1;
+    }
+    struct aio_ctx *ctx = cur->aio;
+    if (!ctx) {
+        ctx = (struct aio_ctx *)kmalloc(sizeof(struct aio_ctx));
+        if (!ctx) {
+            return -1;
+        }
+        cur->aio = ctx;
+    }
+
+    new_ring->sq_head = 0;
+    new_ring->sq_tail = 0;
+    new_ring->cq_head = 0;
+    new_ring->cq_tail = 0;
+    ctx->ring = new_ring;
+    ctx->pending_head = 0;
+    ctx->pending_count = 0;
+    return 0;
+}
+
+int aio_enter(uint32_t to_submit, uint32_t min_complete) {
+    struct aio_ctx *ctx = current_ctx();
+    if (!ctx) {
+        return -1;
+    }
+    aio_ring_t *ring = ctx->ring;
+
+    /* Take SQEs while every accepted request is guaranteed a CQ slot */
+    uint32_t taken = 0;
+    while (taken < to_submit && ring->sq_head != ring->sq_tail &&
+           ctx->pending_count + (ring->cq_tail - ring->cq_head) < AIO_RING_ENTRIES) {
+        ctx->pending[(ctx->pending_head + ctx->pending_count) & RING_MASK] =
+            ring->sq[ring->sq_head & RING_MASK];
+        ctx->pending_count++;
+        ring->sq_head++;
+        taken++;
+    }
+
+    while (ctx->pending_count > 0 && ring->cq_tail - ring->cq_head < min_complete) {
+        aio_poll();
+    }
+
+    return (int)taken;
+}
+
+int aio_poll(void) {
+    struct aio_ctx *ctx = current_ctx();
+    if (!ctx || ctx->pending_count == 0) {
+        return 0;
+    }
+
+    aio_sqe_t sqe = ctx->pending[ctx->pending_head];
+    ctx->pending_head = (ctx->pending_head + 1) & RING_MASK;
+    ctx->pending_count--;
+    aio_run(ctx->ring, &sqe);
+    return 1;
+}
+
+void aio_release(struct aio_ctx *ctx) {
+    if (ctx) {
+        kfree(ctx);
+    }
+}
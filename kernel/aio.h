@@ -0,0 +1,74 @@
+#ifndef AIO_H
+#define AIO_H
+
+#include <stdint.h>
+
+/*
+ * Asynchronous I/O rings shared between a program and the kernel.
+ *
+ * The program owns an aio_ring_t in its memory and registers it once. It
+ * fills SQEs and advances sq_tail, then hands any number of them to the
+ * kernel with one aio_enter call. The kernel copies them into the
+ * process's pending queue, runs as many as were asked for, and works off
+ * the rest whenever the program idles in sleep or getchar. Results are
+ * posted to the CQ, which the program polls by comparing cq_head with
+ * cq_tail; no trap needed.
+ *
+ * Ring and queue belong to the process that registered them (process_t.aio)
+ * and are only touched while it is current, so the ring address always
+ * resolves in its own address space.
+ */
+
+#define AIO_RING_ENTRIES 32  /* SQ and CQ size (power of two) */
+
+/* Operations */
+#define AIO_OP_NOP   0
+#define AIO_OP_OPEN  1  /* addr = filename, len = O_* flags; result = fd */
+#define AIO_OP_READ  2  /* fd, addr = buffer, len; result = bytes read */
+#define AIO_OP_WRITE 3  /* fd, addr = buffer, len; result = bytes written */
+#define AIO_OP_CLOSE 4  /* fd */
+
+/* Submission queue entry */
+typedef struct {
+    uint32_t opcode;
+    int32_t  fd;
+    uint32_t addr;
+    uint32_t len;
+    uint32_t user_data;   /* Copied to the completion */
+} aio_sqe_t;
+
+/* Completion queue entry */
+typedef struct {
+    uint32_t user_data;
+    int32_t  result;      /* -1 on failure */
+} aio_cqe_t;
+
+/* Shared ring (layout mirrored in userspace/libmagnos.h) */
+typedef struct {
+    volatile uint32_t sq_head;    /* Advanced by the kernel */
+    volatile uint32_t sq_tail;    /* Advanced by the program */
+    volatile uint32_t cq_head;    /* Advanced by the program */
+    volatile uint32_t cq_tail;    /* Advanced by the kernel */
+    aio_sqe_t sq[AIO_RING_ENTRIES];
+    aio_cqe_t cq[AIO_RING_ENTRIES];
+} aio_ring_t;
+
+struct aio_ctx;
+
+/* Register the running program's ring (NULL unregisters and drops pending
+ * requests). Returns 0 or -1. */
+int aio_setup(aio_ring_t *ring);
+
+/* Take up to to_submit SQEs, then run pending requests until min_complete
+ * completions are waiting in the CQ. Returns the number of SQEs taken. */
+int aio_enter(uint32_t to_submit, uint32_t min_complete);
+
+/* Run one pending request of the current process; returns 0 if there
+ * was nothing to do */
+int aio_poll(void);
+
+/* Free a process's ring registration and drop its pending requests (when
+ * it exits) */
+void aio_release(struct aio_ctx *ctx);
+
+#endif /* AIO_H */
@@ -0,0 +1,366 @@
+#include "crofs.h"
+#include "ide.h"
+#include "pmm.h"
+#include "heap.h"
+#include "pagecache.h"
+
+#define SECTOR_SIZE     512
+#define BOUNCE_SECTORS  (CROFS_BLOCK_SIZE / SECTOR_SIZE + 1)
+
+/* Disk reads land here; big enough for any block at any sector offset */
+static uint8_t bounce[BOUNCE_SECTORS * SECTOR_SIZE];
+static uint32_t next_id = 0;
+
+typedef struct {
+    uint32_t position;
+} crofs_file_t;
+
+/* Memory functions */
+static void* memcpy(void* dest, const void* src, uint32_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    while (n--) *d++ = *s++;
+    return dest;
+}
+
+static void* memset(void* s, int c, uint32_t n) {
+    uint8_t* p = (uint8_t*)s;
+    while (n--) *p++ = (uint8_t)c;
+    return s;
+}
+
+static int streq(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+/* Copy bytes [offset, offset + len) of the image into dst */
+static int crofs_read_image(crofs_t *sb, uint32_t offset, uint32_t len, uint8_t *dst) {
+    while (len > 0) {
+        uint32_t chunk;
+
+        if (sb->frames) {
+            uint32_t in_page = offset % PAGE_SIZE;
+            chunk = PAGE_SIZE - in_page;
+            if (chunk > len) {
+                chunk = len;
+            }
+            memcpy(dst, (uint8_t *)sb->frames[offset / PAGE_SIZE] + in_page, chunk);
+        } else {
+            uint32_t skip = offset % SECTOR_SIZE;
+            uint32_t sectors = (skip + len + SECTOR_SIZE - 1) / SECTOR_SIZE;
+            if (sectors > BOUNCE_SECTORS) {
+                sectors = BOUNCE_SECTORS;
+            }
+            if (ide_read_sectors(sb->drive, offset / SECTOR_SIZE, (uint8_t)sectors,
+                                 (uint16_t *)bounce) != 0) {
+                return -1;
+            }
+            chunk = sectors * SECTOR_SIZE - skip;
+            if (chunk > len) {
+                chunk = len;
+            }
+            memcpy(dst, bounce + skip, chunk);
+        }
+
+        offset += chunk;
+        dst += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+/* Read an LZ4 length extension (runs of 255 bytes) */
+static int lz4_length(const uint8_t **ip, const uint8_t *end, uint32_t *len) {
+    uint8_t b;
+    do {
+        if (*ip >= end) {
+            return -1;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+/* Decompress one LZ4 block, returns bytes produced or -1 if malformed */
+static int lz4_decompress(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_len) {
+    const uint8_t *ip = src;
+    const uint8_t *end = src + src_len;
+    uint32_t op = 0;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+
+        /* Literals */
+        uint32_t len = token >> 4;
+        if (len == 15 && lz4_length(&ip, end, &len) != 0) {
+            return -1;
+        }
+        if (len > (uint32_t)(end - ip) || len > dst_len - op) {
+            return -1;
+        }
+        memcpy(dst + op, ip, len);
+        ip += len;
+        op += len;
+
+        /* The last sequence ends after its literals */
+        if (ip == end) {
+            break;
+        }
+
+        /* Match: copy from earlier output, may overlap */
+        if (end - ip < 2) {
+            return -1;
+        }
+        uint32_t distance = ip[0] | ((uint32_t)ip[1] << 8);
+        ip += 2;
+        if (distance == 0 || distance > op) {
+            return -1;
+        }
+
+        len = token & 15;
+        if (len == 15 && lz4_length(&ip, end, &len) != 0) {
+            return -1;
+        }
+        len += 4;
+        if (len > dst_len - op) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < len; i++, op++) {
+            dst[op] = dst[op - distance];
+        }
+    }
+
+    return (int)op;
+}
+
+/* Page cache fill: decompress block `index` of the vnode's file */
+static int crofs_fill_page(void *ctx, uint32_t index, uint8_t *page) {
+    vnode_t *vn = (vnode_t *)ctx;
+    crofs_t *sb = (crofs_t *)vn->mount->data;
+    crofs_dirent_t *ent = (crofs_dirent_t *)vn->data;
+
+    if (index >= ent->block_count) {
+        return -1;
+    }
+
+    uint32_t block = ent->first_block + index;
+    uint32_t stored = sb->blocks[block + 1] - sb->blocks[block];
+    uint32_t want = ent->size - index * CROFS_BLOCK_SIZE;
+    if (want > CROFS_BLOCK_SIZE) {
+        want = CROFS_BLOCK_SIZE;
+    }
+
+    if (stored == want) {
+        /* Stored uncompressed */
+        if (crofs_read_image(sb, sb->blocks[block], want, page) != 0) {
+            return -1;
+        }
+    } else {
+        /* Compressed blocks are staged whole, then expanded into the page */
+        static uint8_t packed[CROFS_BLOCK_SIZE];
+        if (stored > sizeof(packed) ||
+            crofs_read_image(sb, sb->blocks[block], stored, packed) != 0 ||
+            lz4_decompress(packed, stored, page, want) != (int)want) {
+            return -1;
+        }
+    }
+
+    memset(page + want, 0, PAGE_SIZE - want);
+    return 0;
+}
+
+crofs_t *crofs_open(uint8_t drive, int ramdisk) {
+    crofs_t probe;
+    crofs_super_t super;
+
+    probe.drive = drive;
+    probe.frames = 0;
+    if (crofs_read_image(&probe, 0, sizeof(super), (uint8_t *)&super) != 0 ||
+        super.magic != CROFS_MAGIC || super.version != CROFS_VERSION ||
+        super.block_size != CROFS_BLOCK_SIZE ||
+        super.meta_size != super.file_count * sizeof(crofs_dirent_t) +
+                           (super.total_blocks + 1) * sizeof(uint32_t)) {
+        return 0;
+    }
+
+    crofs_t *sb = (crofs_t *)kmalloc(sizeof(crofs_t));
+    uint8_t *meta = (uint8_t *)kmalloc(super.meta_size);
+    if (!sb || !meta) {
+        if (sb) kfree(sb);
+        if (meta) kfree(meta);
+        return 0;
+    }
+    *sb = probe;
+    sb->file_count = super.file_count;
+    sb->dir = (crofs_dirent_t *)meta;
+    sb->blocks = (uint32_t *)(meta + super.file_count * sizeof(crofs_dirent_t));
+
+    if (crofs_read_image(sb, SECTOR_SIZE, super.meta_size, meta) != 0) {
+        goto fail;
+    }
+
+    /* Reject tables that point outside the image */
+    for (uint32_t b = 0; b < super.total_blocks; b++) {
+        if (sb->blocks[b] > sb->blocks[b + 1] || sb->blocks[b + 1] > super.image_size) {
+            goto fail;
+        }
+    }
+    for (uint32_t i = 0; i < sb->file_count; i++) {
+        crofs_dirent_t *ent = &sb->dir[i];
+        if (ent->first_block + ent->block_count > super.total_blocks ||
+            ent->block_count != (ent->size + CROFS_BLOCK_SIZE - 1) / CROFS_BLOCK_SIZE) {
+            goto fail;
+        }
+        ent->name[CROFS_NAME_MAX] = '\0';
+    }
+
+    if (ramdisk) {
+        uint32_t pages = (super.image_size + PAGE_SIZE - 1) / PAGE_SIZE;
+        uint32_t *frames = (uint32_t *)kmalloc(pages * sizeof(uint32_t));
+        uint32_t loaded = 0;
+
+        if (frames) {
+            for (; loaded < pages; loaded++) {
+                uint32_t offset = loaded * PAGE_SIZE;
+                uint32_t len = super.image_size - offset;
+                if (len > PAGE_SIZE) {
+                    len = PAGE_SIZE;
+                }
+                frames[loaded] = pmm_alloc();
+                if (!frames[loaded] ||
+                    crofs_read_image(sb, offset, len, (uint8_t *)frames[loaded]) != 0) {
+                    break;
+                }
+            }
+        }
+
+        if (frames && loaded == pages) {
+            sb->frames = frames;
+        } else if (frames) {
+            /* Not enough memory: keep reading from the disk */
+            for (uint32_t i = 0; i <= loaded && i < pages; i++) {
+                if (frames[i]) {
+                    pmm_free(frames[i]);
+                }
+            }
+            kfree(frames);
+        }
+    }
+
+    sb->dev = CROFS_DEV(next_id++);
+    return sb;
+
+fail:
+    kfree(meta);
+    kfree(sb);
+    return 0;
+}
+
+static int crofs_lookup(vfs_mount_t *mnt, const char *name, vnode_t *vn) {
+    crofs_t *sb = (crofs_t *)mnt->data;
+
+    for (uint32_t i = 0; i < sb->file_count; i++) {
+        if (streq(sb->dir[i].name, name)) {
+            vn->ino = i + 1;
+            vn->size = sb->dir[i].size;
+            vn->data = &sb->dir[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void *crofs_open_file(vnode_t *vn, uint32_t flags) {
+    (void)vn;
+    (void)flags;
+    crofs_file_t *file = (crofs_file_t *)kmalloc(sizeof(crofs_file_t));
+    if (file) {
+        file->position = 0;
+    }
+    return file;
+}
+
+static int crofs_read(vfs_file_t *vf, uint8_t *buffer, uint32_t size) {
+    crofs_file_t *file = (crofs_file_t *)vf->handle;
+    vnode_t *vn = vf->vnode;
+    crofs_t *sb = (crofs_t *)vn->mount->data;
+    uint32_t bytes_read = 0;
+
+    if (file->position >= vn->size) {
+        return 0;
+    }
+    if (size > vn->size - file->position) {
+        size = vn->size - file->position;
+    }
+
+    while (bytes_read < size) {
+        uint32_t index = file->position / PAGE_SIZE;
+        uint32_t offset = file->position % PAGE_SIZE;
+        uint32_t chunk = PAGE_SIZE - offset;
+        if (chunk > size - bytes_read) {
+            chunk = size - bytes_read;
+        }
+
+        uint32_t frame = pagecache_get(sb->dev, vn->ino, index, crofs_fill_page, vn);
+        if (!frame) {
+            break;
+        }
+        memcpy(buffer + bytes_read, (uint8_t *)frame + offset, chunk);
+        pagecache_put(sb->dev, vn->ino, index);
+
+        bytes_read += chunk;
+        file->position += chunk;
+    }
+
+    if (bytes_read == 0 && size > 0) {
+        return -1;
+    }
+    return (int)bytes_read;
+}
+
+static int crofs_seek(vfs_file_t *vf, uint32_t offset) {
+    ((crofs_file_t *)vf->handle)->position = offset;
+    return 0;
+}
+
+static uint32_t crofs_tell(vfs_file_t *vf) {
+    return ((crofs_file_t *)vf->handle)->position;
+}
+
+static void crofs_close(vfs_file_t *vf) {
+    kfree(vf->handle);
+}
+
+static int crofs_readdir(vfs_mount_t *mnt, vfs_dirent_t *entries, int max_entries) {
+    crofs_t *sb = (crofs_t *)mnt->data;
+    int count = 0;
+
+    for (uint32_t i = 0; i < sb->file_count && count < max_entries; i++) {
+        memcpy(entries[count].name, sb->dir[i].name, sizeof(entries[count].name) - 1);
+        entries[count].name[sizeof(entries[count].name) - 1] = '\0';
+        entries[count].size = sb->dir[i].size;
+        entries[count].is_directory = 0;
+        count++;
+    }
+    return count;
+}
+
+const vfs_ops_t crofs_ops = {
+    .name = "crofs",
+    .lookup = crofs_lookup,
+    .create = 0,
+    .open = crofs_open_file,
+    .read = crofs_read,
+    .write = 0,
+    .seek = crofs_seek,
+    .tell = crofs_tell,
+    .advise = 0,
+    .close = crofs_close,
+    .unlink = 0,
+    .readdir = crofs_readdir,
+};
@@ -0,0 +1,65 @@
+#ifndef CROFS_H
+#define CROFS_H
+
+#include <stdint.h>
+#include "vfs.h"
+
+/*
+ * crofs: compressed read-only filesystem for system binaries.
+ *
+ * Image layout (little-endian, built by tools/mkcrofs):
+ *   0      superblock (one sector)
+ *   512    directory: file_count crofs_dirent_t
+ *          block table: total_blocks + 1 image offsets; block b is stored
+ *          in [blocks[b], blocks[b + 1])
+ *   ...    block data
+ *
+ * Files are cut into 4KB blocks, each LZ4-compressed on its own so a
+ * page can be filled without touching its neighbours. A block whose
+ * stored length equals its plain length is kept uncompressed.
+ */
+
+#define CROFS_MAGIC       0x53465243  /* "CRFS" */
+#define CROFS_VERSION     1
+#define CROFS_BLOCK_SIZE  4096
+#define CROFS_NAME_MAX    15
+
+/* Page cache device number for a crofs mount */
+#define CROFS_DEV(id)     (0x0800 | (id))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t file_count;
+    uint32_t total_blocks;
+    uint32_t meta_size;         /* Directory + block table, from offset 512 */
+    uint32_t image_size;
+} __attribute__((packed)) crofs_super_t;
+
+typedef struct {
+    char name[CROFS_NAME_MAX + 1];
+    uint32_t size;
+    uint32_t first_block;
+    uint32_t block_count;
+    uint32_t reserved;
+} __attribute__((packed)) crofs_dirent_t;
+
+/* Mounted image */
+typedef struct {
+    uint8_t drive;              /* IDE drive holding the image */
+    uint32_t *frames;           /* RAM disk pages, NULL when read from disk */
+    uint32_t dev;
+    uint32_t file_count;
+    crofs_dirent_t *dir;
+    uint32_t *blocks;
+} crofs_t;
+
+/* Open the image on an IDE drive. With ramdisk set the whole image is
+ * copied into memory first, so reads never touch the disk again.
+ * Returns NULL when the drive holds no valid image. */
+crofs_t *crofs_open(uint8_t drive, int ramdisk);
+
+extern const vfs_ops_t crofs_ops;
+
+#endif /* CROFS_H */
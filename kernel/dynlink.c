@@ -0,0 +1,144 @@
+#include "dynlink.h"
+#include "elf.h"
+#include "vga.h"
+#include "heap.h"
+#include "paging.h"
+
+static exec_image_t *lib_image = 0;
+static vfs_file_t *lib_file = 0;
+
+/* Copies of the library's dynamic symbol, string and SysV hash tables */
+static elf32_sym_t *symtab = 0;
+static char *strtab = 0;
+static uint32_t strsz = 0;
+static uint32_t nbucket = 0;
+static uint32_t *buckets = 0;    /* nbucket entries, then the chains */
+static uint32_t *chains = 0;
+static uint32_t nchain = 0;
+
+static int streq(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static uint32_t elf_hash(const char *name) {
+    uint32_t h = 0;
+    while (*name) {
+        h = (h << 4) + (uint8_t)*name++;
+        uint32_t g = h & 0xF0000000;
+        if (g) {
+            h ^= g >> 24;
+        }
+        h &= ~g;
+    }
+    return h;
+}
+
+/* Copy len bytes at the library's loaded address addr into a new buffer */
+static void *read_table(uint32_t addr, uint32_t len) {
+    int32_t off = elf_file_offset(lib_image->segs, lib_image->count, addr, len);
+    void *buf = off >= 0 && len ? kmalloc(len) : 0;
+    if (buf && elf_read_at(lib_file, (uint32_t)off, buf, len) != 0) {
+        kfree(buf);
+        buf = 0;
+    }
+    return buf;
+}
+
+static void free_tables(void) {
+    if (symtab) kfree(symtab);
+    if (strtab) kfree(strtab);
+    if (buckets) kfree(buckets);
+    symtab = 0;
+    strtab = 0;
+    buckets = 0;
+    chains = 0;
+}
+
+int dynlink_is_library(const char *name) {
+    return streq(name, DYNLINK_LIB_NAME);
+}
+
+int dynlink_load(void) {
+    if (lib_image) {
+        return 0;
+    }
+
+    vfs_file_t *file = elf_open(DYNLINK_LIB_NAME);
+    if (!file) {
+        vga_puts("exec: " DYNLINK_LIB_NAME " not found\n");
+        return ELF_ERR_LOAD;
+    }
+
+    exec_image_t *img;
+    elf32_phdr_t dynamic;
+    int err = elf_read_image(file, USER_LIB_BASE, USER_STACK_GUARD, &img, &dynamic);
+    if (err != 0) {
+        vfs_close(file);
+        return err;
+    }
+    lib_image = img;
+    lib_file = file;
+
+    /* Find the export tables through the DYNAMIC segment */
+    uint32_t hash = 0, sym = 0, str = 0;
+    for (uint32_t off = 0; off + sizeof(elf32_dyn_t) <= dynamic.p_filesz; off += sizeof(elf32_dyn_t)) {
+        elf32_dyn_t dyn;
+        if (dynamic.p_type != PT_DYNAMIC ||
+            elf_read_at(file, dynamic.p_offset + off, &dyn, sizeof(dyn)) != 0 ||
+            dyn.d_tag == DT_NULL) {
+            break;
+        }
+        if (dyn.d_tag == DT_HASH) hash = dyn.d_val + img->relocs.bias;
+        if (dyn.d_tag == DT_SYMTAB) sym = dyn.d_val + img->relocs.bias;
+        if (dyn.d_tag == DT_STRTAB) str = dyn.d_val + img->relocs.bias;
+        if (dyn.d_tag == DT_STRSZ) strsz = dyn.d_val;
+    }
+
+    uint32_t *head = hash ? (uint32_t *)read_table(hash, 2 * sizeof(uint32_t)) : 0;
+    if (head) {
+        nbucket = head[0];
+        nchain = head[1];
+        kfree(head);
+        buckets = (uint32_t *)read_table(hash + 2 * sizeof(uint32_t),
+                                         (nbucket + nchain) * sizeof(uint32_t));
+        chains = buckets ? buckets + nbucket : 0;
+        symtab = (elf32_sym_t *)read_table(sym, nchain * sizeof(elf32_sym_t));
+        strtab = (char *)read_table(str, strsz);
+    }
+    if (!buckets || !symtab || !strtab || nbucket == 0 || strtab[strsz - 1] != '\0') {
+        vga_puts("exec: " DYNLINK_LIB_NAME " has no usable symbol hash table\n");
+        free_tables();
+        execcache_put(img);
+        vfs_close(file);
+        lib_image = 0;
+        lib_file = 0;
+        return ELF_ERR_FORMAT;
+    }
+    return 0;
+}
+
+uint32_t dynlink_lookup(const char *name) {
+    if (!lib_image) {
+        return 0;
+    }
+
+    for (uint32_t i = buckets[elf_hash(name) % nbucket]; i && i < nchain; i = chains[i]) {
+        elf32_sym_t *s = &symtab[i];
+        if (s->st_shndx != SHN_UNDEF && s->st_name < strsz && streq(strtab + s->st_name, name)) {
+            return s->st_value + lib_image->relocs.bias;
+        }
+    }
+    return 0;
+}
+
+exec_image_t *dynlink_image(void) {
+    return lib_image;
+}
+
+vfs_file_t *dynlink_file(void) {
+    return lib_file;
+}
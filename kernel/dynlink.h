@@ -0,0 +1,32 @@
+#ifndef DYNLINK_H
+#define DYNLINK_H
+
+#include <stdint.h>
+#include "vfs.h"
+#include "execcache.h"
+
+/*
+ * Minimal dynamic linker for the one resident shared library. It is
+ * loaded on first use, kept for good, and appears at USER_LIB_BASE in
+ * every program linked against it. Its read-only pages come out of the
+ * exec cache, so all of them share one set of frames. Programs bind to
+ * its exports at load time through the library's hash table.
+ */
+
+#define DYNLINK_LIB_NAME  "libmagnos.so"
+#define DYNLINK_NAME_MAX  32    /* Longest symbol or library name, with NUL */
+
+/* Nonzero if name is the library that can be linked against */
+int dynlink_is_library(const char *name);
+
+/* Load the library if it is not resident yet, 0 or an ELF_ERR_* code */
+int dynlink_load(void);
+
+/* Address of an exported symbol, 0 if the library does not define it */
+uint32_t dynlink_lookup(const char *name);
+
+/* Image and open file backing the library's pages (after dynlink_load) */
+exec_image_t *dynlink_image(void);
+vfs_file_t *dynlink_file(void);
+
+#endif /* DYNLINK_H */
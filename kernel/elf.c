@@ -4,6 +4,13 @@
 #include "paging.h"
 #include "pmm.h"
 #include "gdt.h"
+#include "vfs.h"
+#include "process.h"
+#include "execcache.h"
+#include "heap.h"
+#include "dynlink.h"
+#include "mman.h"
+#include "file.h"
 
 /* setjmp/longjmp context buffer */
 typedef struct {
@@ -13,10 +20,18 @@ typedef struct {
 extern int exec_setjmp(exec_jmp_buf *buf) __attribute__((returns_twice));
 extern void exec_longjmp(exec_jmp_buf *buf, int val) __attribute__((noreturn));
 
-/* Stack of saved contexts for nested exec */
+/*
+ * Each program process holds its image and open file (pages are filled
+ * from the exec cache, or from the file on first touch) and, when it was
+ * exec'd rather than forked, the context to return to in its parent.
+ *
+ * Nested execs all run on the kernel stack of the process at the bottom
+ * of the chain: PID 0's boot stack, or the single page a forked or
+ * spawned process has to itself, which holds fewer levels (each takes
+ * about 0.5KB, and loading or a page fault needs up to 2KB more on top).
+ */
 #define MAX_EXEC_DEPTH 8
-static exec_jmp_buf exec_stack[MAX_EXEC_DEPTH];
-static volatile int exec_depth = 0;
+#define MAX_EXEC_DEPTH_PAGE_STACK 3
 
 /* Memory functions */
 static void* memcpy(void* dest, const void* src, uint32_t n) {
@@ -65,73 +80,536 @@ int elf_validate_header(elf32_ehdr_t *header) {
     return 0;
 }
 
-/* Load and execute an ELF binary */
-int elf_load_and_exec(uint8_t *elf_data, uint32_t size) {
-    /* Parse ELF header */
-    elf32_ehdr_t *elf_header = (elf32_ehdr_t *)elf_data;
+/* Read exactly len bytes at offset of file, 0 or -1 */
+int elf_read_at(vfs_file_t *file, uint32_t offset, void *buf, uint32_t len) {
+    if (vfs_seek(file, offset) != 0 || vfs_read(file, (uint8_t *)buf, len) != (int)len) {
+        return -1;
+    }
+    return 0;
+}
 
-    /* Validate header */
-    if (elf_validate_header(elf_header) != 0) {
-        vga_puts("Invalid ELF header\n");
+/* Patch every relocated word of a freshly read page */
+static void elf_apply_relocs(const elf_relocs_t *relocs, uint32_t page, uint32_t frame) {
+    /* First fixup at or above page: entries are sorted */
+    uint32_t lo = 0, hi = relocs->count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (relocs->entries[mid].addr < page) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (uint32_t i = lo; i < relocs->count && relocs->entries[i].addr < page + PAGE_SIZE; i++) {
+        const elf_reloc_t *r = &relocs->entries[i];
+        uint32_t *word = (uint32_t *)(frame + (r->addr - page));
+        switch (r->type) {
+            case R_386_RELATIVE:
+            case R_386_32:
+                *word += r->value;
+                break;
+            case R_386_PC32:
+                *word += r->value - r->addr;
+                break;
+            default:  /* GLOB_DAT, JMP_SLOT */
+                *word = r->value;
+                break;
+        }
+    }
+}
+
+/* Fill and map the page at `page` of the running program. Returns 0, or
+ * -1 if no segment covers it or memory ran out. */
+static int elf_fill_page(exec_image_t *img, vfs_file_t *file, uint32_t page) {
+    uint32_t flags = 0;
+    int covered = 0;
+
+    for (int i = 0; i < img->count; i++) {
+        elf_segment_t *seg = &img->segs[i];
+        if (page < seg->vaddr + seg->memsz && page + PAGE_SIZE > seg->vaddr) {
+            covered = 1;
+            if (seg->flags & PF_W) {
+                flags |= PAGE_WRITABLE;
+            }
+        }
+    }
+    if (!covered) {
         return -1;
     }
 
-    /* Get program headers */
-    elf32_phdr_t *ph = (elf32_phdr_t *)(elf_data + elf_header->e_phoff);
+    /* Read-only pages map the cached frame itself, shared by every instance */
+    uint32_t cached = execcache_page(img, page);
+    if (cached && !(flags & PAGE_WRITABLE)) {
+        if (pmm_ref(cached) != 0) {
+            return -1;
+        }
+        if (paging_map_user(current_page_directory, page, cached, flags) != 0) {
+            pmm_free(cached);
+            return -1;
+        }
+        return 0;
+    }
 
-    /* Load all LOAD segments */
-    for (int i = 0; i < elf_header->e_phnum; i++) {
-        if (ph[i].p_type == PT_LOAD) {
-            /* Calculate load address */
-            uint8_t *dest = (uint8_t *)ph[i].p_vaddr;
+    /* Fill through the direct map, so read-only pages need no write access */
+    uint32_t frame = pmm_alloc();
+    if (!frame) {
+        return -1;
+    }
 
-            /* Copy segment data */
-            if (ph[i].p_filesz > 0) {
-                memcpy(dest, elf_data + ph[i].p_offset, ph[i].p_filesz);
+    if (cached) {
+        memcpy((void *)frame, (void *)cached, PAGE_SIZE);
+    } else {
+        memset((void *)frame, 0, PAGE_SIZE);
+    }
+
+    int from_file = 0;
+    for (int i = 0; i < img->count && !cached; i++) {
+        elf_segment_t *seg = &img->segs[i];
+        uint32_t lo = seg->vaddr > page ? seg->vaddr : page;
+        uint32_t hi = seg->vaddr + seg->filesz;
+        if (hi > page + PAGE_SIZE) {
+            hi = page + PAGE_SIZE;
+        }
+        if (lo >= hi) {
+            continue;  /* BSS only: stays zero */
+        }
+        if (elf_read_at(file, seg->offset + (lo - seg->vaddr),
+                        (uint8_t *)frame + (lo - page), hi - lo) != 0) {
+            pmm_free(frame);
+            return -1;
+        }
+        from_file = 1;
+    }
+    if (!cached) {
+        elf_apply_relocs(&img->relocs, page, frame);
+    }
+    if (from_file) {
+        execcache_store(img, page, frame, !(flags & PAGE_WRITABLE));
+    }
+
+    if (paging_map_user(current_page_directory, page, frame, flags) != 0) {
+        pmm_free(frame);
+        return -1;
+    }
+    return 0;
+}
+
+int elf_page_fault(uint32_t addr, uint32_t err_code, uint32_t esp) {
+    process_t *proc = process_get_current();
+
+    /* Only missing pages in the running program's window can be filled */
+    if (!proc || !proc->image || (err_code & 0x1) ||
+        addr < USER_BASE || addr >= USER_STACK_TOP) {
+        return -1;
+    }
+
+    uint32_t page = addr & 0xFFFFF000;
+    if (page >= USER_STACK_GUARD) {
+        return mman_stack_fault(addr, esp);
+    }
+    if (paging_user_entry(current_page_directory, page) & PAGE_ANON) {
+        return mman_fault(page);
+    }
+    if (page >= USER_LIB_BASE) {
+        if (!proc->image->needs_lib) {
+            return -1;
+        }
+        return elf_fill_page(dynlink_image(), dynlink_file(), page);
+    }
+    return elf_fill_page(proc->image, proc->image_file, page);
+}
+
+/* Exec levels on the current kernel stack; *limit gets how many it holds */
+static int exec_depth(int *limit) {
+    int depth = 0;
+    process_t *p = process_get_current();
+    while (p && !p->kernel_stack) {  /* Runs on its parent's stack */
+        depth++;
+        p = process_get(p->parent);
+    }
+    *limit = (p && p->pid != 0) ? MAX_EXEC_DEPTH_PAGE_STACK : MAX_EXEC_DEPTH;
+    return depth;
+}
+
+int32_t elf_file_offset(const elf_segment_t *segs, int count, uint32_t addr, uint32_t len) {
+    for (int i = 0; i < count; i++) {
+        if (addr >= segs[i].vaddr && addr - segs[i].vaddr <= segs[i].filesz &&
+            len <= segs[i].filesz - (addr - segs[i].vaddr)) {
+            return (int32_t)(segs[i].offset + (addr - segs[i].vaddr));
+        }
+    }
+    return -1;
+}
+
+/* Where a program keeps its dynamic symbols */
+typedef struct {
+    vfs_file_t *file;
+    const elf_segment_t *segs;
+    int count;
+    uint32_t symtab;            /* Loaded addresses */
+    uint32_t strtab;
+    uint32_t bias;
+} elf_symbols_t;
+
+/* NUL-terminated string at loaded address addr, 0 or -1 if unreadable or too long */
+static int elf_read_string(const elf_symbols_t *syms, uint32_t addr, char *buf, uint32_t size) {
+    int32_t off = elf_file_offset(syms->segs, syms->count, addr, 1);
+    if (off < 0) {
+        return -1;
+    }
+    uint32_t len = syms->file->vnode->size - (uint32_t)off;
+    if (len > size) {
+        len = size;
+    }
+    if (elf_read_at(syms->file, (uint32_t)off, buf, len) != 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        if (buf[i] == '\0') {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* Address of dynamic symbol idx: the program's own definition, else the
+ * resident library's export. Returns 0, or -1 if it cannot be resolved. */
+static int elf_resolve_symbol(const elf_symbols_t *syms, uint32_t idx, uint32_t *value) {
+    elf32_sym_t sym;
+    char name[DYNLINK_NAME_MAX];
+
+    int32_t off = elf_file_offset(syms->segs, syms->count, syms->symtab + idx * sizeof(sym), sizeof(sym));
+    if (off < 0 || elf_read_at(syms->file, (uint32_t)off, &sym, sizeof(sym)) != 0) {
+        return -1;
+    }
+    if (sym.st_shndx != SHN_UNDEF) {
+        *value = sym.st_value + syms->bias;
+        return 0;
+    }
+    if (elf_read_string(syms, syms->strtab + sym.st_name, name, sizeof(name)) != 0) {
+        return -1;
+    }
+    *value = dynlink_lookup(name);
+    if (*value || ELF32_ST_BIND(sym.st_info) == STB_WEAK) {
+        return 0;
+    }
+    vga_puts("exec: undefined symbol ");
+    vga_puts(name);
+    vga_puts("\n");
+    return -1;
+}
+
+/* Resolve one table of REL entries into relocs (kept sorted by address) */
+static int elf_add_relocs(const elf_symbols_t *syms, uint32_t table, uint32_t size,
+                          elf_relocs_t *relocs) {
+    int32_t off = elf_file_offset(syms->segs, syms->count, table, size);
+    if (off < 0) {
+        vga_puts("exec: bad relocation table\n");
+        return ELF_ERR_LOAD;
+    }
+
+    /* Read in batches; keep each patched word inside one page */
+    elf32_rel_t batch[32];
+    uint32_t n = size / sizeof(elf32_rel_t);
+    for (uint32_t i = 0; i < n; i += 32) {
+        uint32_t chunk = n - i < 32 ? n - i : 32;
+        if (elf_read_at(syms->file, (uint32_t)off + i * sizeof(elf32_rel_t), batch,
+                        chunk * sizeof(elf32_rel_t)) != 0) {
+            return ELF_ERR_READ;
+        }
+        for (uint32_t j = 0; j < chunk; j++) {
+            uint32_t type = ELF32_R_TYPE(batch[j].r_info);
+            elf_reloc_t r;
+            r.addr = batch[j].r_offset + relocs->bias;
+            r.type = type;
+            r.value = relocs->bias;
+
+            if (type == R_386_NONE) {
+                continue;
+            }
+            if (elf_file_offset(syms->segs, syms->count, r.addr, 4) < 0 ||
+                (r.addr & 0xFFF) > PAGE_SIZE - 4) {
+                vga_puts("exec: bad relocation\n");
+                return ELF_ERR_LOAD;
+            }
+            if (type == R_386_32 || type == R_386_PC32 ||
+                type == R_386_GLOB_DAT || type == R_386_JMP_SLOT) {
+                if (elf_resolve_symbol(syms, ELF32_R_SYM(batch[j].r_info), &r.value) != 0) {
+                    return ELF_ERR_LOAD;
+                }
+            } else if (type != R_386_RELATIVE) {
+                vga_puts("exec: unsupported relocation\n");
+                return ELF_ERR_LOAD;
             }
 
-            /* Zero out remaining memory (BSS) */
-            if (ph[i].p_memsz > ph[i].p_filesz) {
-                memset(dest + ph[i].p_filesz, 0, ph[i].p_memsz - ph[i].p_filesz);
+            /* Linkers emit each table in address order; keep the merge sorted */
+            uint32_t k = relocs->count++;
+            while (k > 0 && relocs->entries[k - 1].addr > r.addr) {
+                relocs->entries[k] = relocs->entries[k - 1];
+                k--;
             }
+            relocs->entries[k] = r;
         }
     }
+    return 0;
+}
 
-    /* Get entry point */
-    uint32_t entry = elf_header->e_entry;
+/*
+ * Collect the fixups named by the DYNAMIC segment of a position-independent
+ * program. Symbols bind immediately, either to the program's own
+ * definitions or to the resident library (the only DT_NEEDED allowed),
+ * which is loaded on first use.
+ */
+static int elf_read_relocs(vfs_file_t *file, const elf32_phdr_t *dynamic,
+                           const elf_segment_t *segs, int count, elf_relocs_t *relocs,
+                           uint8_t *needs_lib) {
+    uint32_t rel = 0, relsz = 0, relent = sizeof(elf32_rel_t);
+    uint32_t jmprel = 0, pltrelsz = 0, pltrel = DT_REL;
+    uint32_t needed[4];
+    int num_needed = 0;
+    elf_symbols_t syms = { file, segs, count, 0, 0, relocs->bias };
 
-    vga_puts("Executing binary at ");
-    vga_puthex(entry);
-    vga_puts("\n");
+    for (uint32_t off = 0; off + sizeof(elf32_dyn_t) <= dynamic->p_filesz; off += sizeof(elf32_dyn_t)) {
+        elf32_dyn_t dyn;
+        if (elf_read_at(file, dynamic->p_offset + off, &dyn, sizeof(dyn)) != 0) {
+            return ELF_ERR_READ;
+        }
+        if (dyn.d_tag == DT_NULL) {
+            break;
+        }
+        switch (dyn.d_tag) {
+            case DT_REL:      rel = dyn.d_val + relocs->bias; break;
+            case DT_RELSZ:    relsz = dyn.d_val; break;
+            case DT_RELENT:   relent = dyn.d_val; break;
+            case DT_JMPREL:   jmprel = dyn.d_val + relocs->bias; break;
+            case DT_PLTRELSZ: pltrelsz = dyn.d_val; break;
+            case DT_PLTREL:   pltrel = dyn.d_val; break;
+            case DT_SYMTAB:   syms.symtab = dyn.d_val + relocs->bias; break;
+            case DT_STRTAB:   syms.strtab = dyn.d_val + relocs->bias; break;
+            case DT_NEEDED:
+                if (num_needed == 4) {
+                    return ELF_ERR_LOAD;
+                }
+                needed[num_needed++] = dyn.d_val;
+                break;
+            case DT_RELA:
+                vga_puts("exec: RELA relocations not supported\n");
+                return ELF_ERR_LOAD;
+        }
+    }
+    if (relent != sizeof(elf32_rel_t) || pltrel != DT_REL) {
+        vga_puts("exec: bad relocation table\n");
+        return ELF_ERR_LOAD;
+    }
+
+    /* Only the resident library can be linked against */
+    for (int i = 0; i < num_needed; i++) {
+        char name[DYNLINK_NAME_MAX];
+        if (elf_read_string(&syms, syms.strtab + needed[i], name, sizeof(name)) != 0 ||
+            !dynlink_is_library(name)) {
+            vga_puts("exec: unknown shared library\n");
+            return ELF_ERR_LOAD;
+        }
+        int err = dynlink_load();
+        if (err != 0) {
+            return err;
+        }
+        *needs_lib = 1;
+    }
+
+    uint32_t n = (relsz + pltrelsz) / sizeof(elf32_rel_t);
+    if (n == 0) {
+        return 0;
+    }
+    relocs->entries = (elf_reloc_t *)kmalloc(n * sizeof(elf_reloc_t));
+    if (!relocs->entries) {
+        return ELF_ERR_LOAD;
+    }
+
+    int err = 0;
+    if (relsz) {
+        err = elf_add_relocs(&syms, rel, relsz, relocs);
+    }
+    if (err == 0 && pltrelsz) {
+        err = elf_add_relocs(&syms, jmprel, pltrelsz, relocs);
+    }
+    if (err != 0) {
+        kfree(relocs->entries);
+        relocs->entries = 0;
+        relocs->count = 0;
+    }
+    return err;
+}
+
+int elf_read_image(vfs_file_t *file, uint32_t base, uint32_t limit,
+                   exec_image_t **out, elf32_phdr_t *dynamic) {
+    elf32_ehdr_t header;
+    elf_segment_t segs[ELF_MAX_SEGMENTS];
+    int count = 0;
+
+    if (file->vnode->size < sizeof(header)) {
+        return ELF_ERR_FORMAT;
+    }
+    if (elf_read_at(file, 0, &header, sizeof(header)) != 0) {
+        return ELF_ERR_READ;
+    }
+
+    /* Validate header */
+    if (elf_validate_header(&header) != 0 ||
+        header.e_phentsize != sizeof(elf32_phdr_t)) {
+        vga_puts("Invalid ELF header\n");
+        return ELF_ERR_FORMAT;
+    }
+
+    /* Position-independent images are placed at the bottom of their range */
+    elf_relocs_t relocs = { 0, 0, 0 };
+    uint8_t needs_lib = 0;
+    dynamic->p_type = PT_NULL;
+    if (header.e_type == ET_DYN) {
+        uint32_t lowest = 0xFFFFFFFF;
+        for (int i = 0; i < header.e_phnum; i++) {
+            elf32_phdr_t phdr;
+            if (elf_read_at(file, header.e_phoff + i * sizeof(phdr), &phdr, sizeof(phdr)) != 0) {
+                return ELF_ERR_READ;
+            }
+            if (phdr.p_type == PT_LOAD && phdr.p_vaddr < lowest) {
+                lowest = phdr.p_vaddr;
+            } else if (phdr.p_type == PT_DYNAMIC) {
+                *dynamic = phdr;
+            }
+        }
+        if (lowest == 0xFFFFFFFF) {
+            return ELF_ERR_FORMAT;
+        }
+        relocs.bias = base - (lowest & 0xFFFFF000);
+    }
+
+    /* Record the LOAD segments that fall in the user window; nothing is
+     * copied until the program touches a page */
+    for (int i = 0; i < header.e_phnum; i++) {
+        elf32_phdr_t phdr;
+
+        if (elf_read_at(file, header.e_phoff + i * sizeof(phdr), &phdr, sizeof(phdr)) != 0) {
+            return ELF_ERR_READ;
+        }
+        if (phdr.p_type != PT_LOAD) {
+            continue;
+        }
+
+        uint32_t start = phdr.p_vaddr + relocs.bias;
+        uint32_t end = start + phdr.p_memsz;
+
+        /* Headers and notes some linkers place elsewhere are not needed */
+        if (end <= USER_BASE || start >= USER_STACK_PAGE) {
+            continue;
+        }
+        if (start < base || end > limit || end < start ||
+            phdr.p_filesz > phdr.p_memsz ||
+            phdr.p_offset + phdr.p_filesz > file->vnode->size ||
+            count == ELF_MAX_SEGMENTS) {
+            vga_puts("exec: bad or oversized segment\n");
+            return ELF_ERR_LOAD;
+        }
 
+        segs[count].vaddr = start;
+        segs[count].memsz = phdr.p_memsz;
+        segs[count].filesz = phdr.p_filesz;
+        segs[count].offset = phdr.p_offset;
+        segs[count].flags = phdr.p_flags;
+        count++;
+    }
+    if (count == 0) {
+        return ELF_ERR_FORMAT;
+    }
+
+    if (dynamic->p_type == PT_DYNAMIC) {
+        int err = elf_read_relocs(file, dynamic, segs, count, &relocs, &needs_lib);
+        if (err != 0) {
+            return err;
+        }
+    }
+
+    *out = execcache_insert(file->vnode, header.e_entry + relocs.bias, segs, count, &relocs);
+    if (!*out) {
+        if (relocs.entries) kfree(relocs.entries);
+        return ELF_ERR_LOAD;
+    }
+    (*out)->needs_lib = needs_lib;
+    return 0;
+}
+
+/* Referenced image of file: repeat launches reuse the validated image
+ * without reading the file. Returns 0 or an ELF_ERR_* code. */
+static int elf_get_image(vfs_file_t *file, exec_image_t **out) {
+    elf32_phdr_t dynamic;
+    *out = execcache_lookup(file->vnode);
+    return *out ? 0 : elf_read_image(file, USER_BASE, USER_LIB_BASE, out, &dynamic);
+}
+
+/* Load and execute an ELF binary in a fresh address space */
+int elf_load_and_exec(const char *name, vfs_file_t *file) {
     /* Check nesting depth */
-    if (exec_depth >= MAX_EXEC_DEPTH) {
+    int limit;
+    if (exec_depth(&limit) >= limit) {
         vga_puts("exec: max nesting depth reached\n");
-        return -1;
+        vfs_close(file);
+        return ELF_ERR_LOAD;
     }
 
-    /* Mark userspace pages as user-accessible */
-    for (uint32_t addr = 0x200000; addr < 0x300000; addr += PAGE_SIZE) {
-        paging_map(addr, addr, PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER);
+    exec_image_t *img;
+    int err = elf_get_image(file, &img);
+    if (err != 0) {
+        vfs_close(file);
+        return err;
+    }
+
+    /* The program gets its own address space; the caller's stays intact */
+    uint32_t *space = paging_create_space();
+    if (!space) {
+        vga_puts("exec: out of memory\n");
+        execcache_put(img);
+        vfs_close(file);
+        return ELF_ERR_LOAD;
+    }
+    process_t *child = process_start_exec(name, space);
+    if (!child) {
+        paging_destroy_space(space);
+        vga_puts("exec: process table full\n");
+        execcache_put(img);
+        vfs_close(file);
+        return ELF_ERR_LOAD;
     }
-    /* Map user stack page */
-    paging_map(0x300000, 0x300000, PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER);
+    exec_jmp_buf ctx;
+    file_inherit(child, process_get(child->parent));
+    child->image = img;
+    child->image_file = file;
+    child->exec_ctx = &ctx;
+    mman_init(child, img->base + img->num_pages * PAGE_SIZE);
+
+    /* Get entry point */
+    uint32_t entry = img->entry;
+
+    vga_puts("Executing binary at ");
+    vga_puthex(entry);
+    vga_puts("\n");
 
     /* Save context; returns 0 on save, 1 when restored by elf_return_to_kernel */
-    int depth = exec_depth++;
     uint32_t saved_esp0;
     __asm__ volatile("mov %%esp, %0" : "=r"(saved_esp0));
 
-    if (exec_setjmp(&exec_stack[depth]) != 0) {
-        /* Returned from program exit — restore TSS kernel stack */
-        exec_depth--;
+    if (exec_setjmp(&ctx) != 0) {
+        /* Returned from program exit — back to the caller's address space */
         tss_set_kernel_stack(saved_esp0);
+        process_end_exec(child);
+        execcache_put(img);
+        vfs_close(file);
         return 0;
     }
 
     /* Set TSS.esp0 so interrupts from ring 3 use correct kernel stack position */
     uint32_t current_esp;
     __asm__ volatile("mov %%esp, %0" : "=r"(current_esp));
+    child->esp0 = current_esp;
     tss_set_kernel_stack(current_esp);
 
     /* Switch to ring 3 via iret */
@@ -142,25 +620,93 @@ int elf_load_and_exec(uint8_t *elf_data, uint32_t size) {
         "mov %%ax, %%fs\n\t"
         "mov %%ax, %%gs\n\t"
         "pushl $0x23\n\t"         /* SS = USER_DS */
-        "pushl $0x301000\n\t"     /* ESP = top of user stack */
+        "pushl %[stack]\n\t"      /* ESP = top of user stack */
         "pushfl\n\t"              /* EFLAGS */
         "orl $0x200, (%%esp)\n\t" /* Ensure IF is set */
         "pushl $0x1B\n\t"         /* CS = USER_CS = 0x18 | RPL 3 */
         "pushl %%esi\n\t"         /* EIP = entry point */
         "iret"
         :
-        : "S"(entry)
+        : "S"(entry), [stack] "i"(USER_STACK_TOP)
         : "memory", "eax"
     );
 
     /* Unreachable — return is via SYSCALL_EXIT → longjmp */
-    exec_depth--;
     return 0;
 }
 
+int elf_spawn(const char *name, vfs_file_t *file, program_args_t *args) {
+    exec_image_t *img;
+    int err = elf_get_image(file, &img);
+    if (err != 0) {
+        vfs_close(file);
+        return err;
+    }
+
+    uint32_t *space = paging_create_space();
+    process_t *child = space ? process_spawn(name, space, img->entry, USER_STACK_TOP) : 0;
+    if (!child) {
+        if (space) paging_destroy_space(space);
+        vga_puts("spawn: out of memory or process table full\n");
+        execcache_put(img);
+        vfs_close(file);
+        return ELF_ERR_LOAD;
+    }
+
+    child->image = img;
+    child->image_file = file;
+    child->args = args;
+    file_inherit(child, process_get_current());
+    mman_init(child, img->base + img->num_pages * PAGE_SIZE);
+    process_wake(child);
+    return (int)child->pid;
+}
+
 /* Return from userspace to kernel (called by exit syscall) */
-void elf_return_to_kernel(void) {
-    if (exec_depth > 0) {
-        exec_longjmp(&exec_stack[exec_depth - 1], 1);
+void elf_return_to_kernel(int code) {
+    process_t *proc = process_get_current();
+    if (!proc || !proc->image) {
+        return;
+    }
+
+    /* An exec'd program resumes its parent inside elf_load_and_exec */
+    if (proc->exec_ctx) {
+        exec_longjmp((exec_jmp_buf *)proc->exec_ctx, 1);
     }
+
+    /* A forked or spawned program has no caller to return to */
+    execcache_put(proc->image);
+    vfs_close(proc->image_file);
+    proc->image = 0;
+    proc->image_file = 0;
+    process_exit(code);
+}
+
+int elf_running(void) {
+    process_t *proc = process_get_current();
+    return proc && proc->image;
+}
+
+/* Open a program by name: bare names try EXEC_PATH before the root */
+vfs_file_t *elf_open(const char *name) {
+    char path[VFS_PATH_MAX + VFS_NAME_MAX + 1];
+    const char *prefix = EXEC_PATH "/";
+    int i = 0;
+
+    for (const char *p = name; *p; p++) {
+        if (*p == '/') {
+            return vfs_open(name, 0);
+        }
+    }
+
+    while (*prefix) {
+        path[i++] = *prefix++;
+    }
+    for (int j = 0; name[j] && j < VFS_NAME_MAX + 1; j++) {
+        path[i++] = name[j];
+    }
+    path[i] = '\0';
+
+    vfs_file_t *file = vfs_open(path, 0);
+    return file ? file : vfs_open(name, 0);
 }
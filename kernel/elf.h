@@ -2,6 +2,8 @@
 #define ELF_H
 
 #include <stdint.h>
+#include "vfs.h"
+#include "args.h"
 
 /* ELF-32 Header */
 #define EI_NIDENT 16
@@ -35,6 +37,35 @@ typedef struct {
     uint32_t p_align;              /* Segment alignment */
 } __attribute__((packed)) elf32_phdr_t;
 
+/* ELF-32 Dynamic section entry */
+typedef struct {
+    int32_t  d_tag;                /* Entry type */
+    uint32_t d_val;                /* Integer or address value */
+} __attribute__((packed)) elf32_dyn_t;
+
+/* ELF-32 Relocation (implicit addend) */
+typedef struct {
+    uint32_t r_offset;             /* Address to patch */
+    uint32_t r_info;               /* Symbol index and type */
+} __attribute__((packed)) elf32_rel_t;
+
+#define ELF32_R_SYM(info)  ((info) >> 8)
+#define ELF32_R_TYPE(info) ((info) & 0xFF)
+
+/* ELF-32 Symbol table entry */
+typedef struct {
+    uint32_t st_name;              /* String table offset */
+    uint32_t st_value;             /* Symbol value */
+    uint32_t st_size;              /* Symbol size */
+    uint8_t  st_info;              /* Type and binding */
+    uint8_t  st_other;             /* Visibility */
+    uint16_t st_shndx;             /* Section index, SHN_UNDEF if imported */
+} __attribute__((packed)) elf32_sym_t;
+
+#define SHN_UNDEF          0
+#define ELF32_ST_BIND(info) ((info) >> 4)
+#define STB_WEAK           2
+
 /* ELF identification */
 #define EI_MAG0    0
 #define EI_MAG1    1
@@ -67,18 +98,110 @@ typedef struct {
 #define PT_INTERP  3
 #define PT_NOTE    4
 
+/* Dynamic section tags */
+#define DT_NULL     0
+#define DT_NEEDED   1
+#define DT_PLTRELSZ 2
+#define DT_HASH     4
+#define DT_STRTAB   5
+#define DT_SYMTAB   6
+#define DT_RELA     7
+#define DT_STRSZ    10
+#define DT_REL      17
+#define DT_RELSZ    18
+#define DT_RELENT   19
+#define DT_PLTREL   20
+#define DT_JMPREL   23
+
+/* i386 relocation types */
+#define R_386_NONE      0
+#define R_386_32        1
+#define R_386_PC32      2
+#define R_386_GLOB_DAT  6
+#define R_386_JMP_SLOT  7
+#define R_386_RELATIVE  8
+
 /* Program header flags */
 #define PF_X       0x1  /* Execute */
 #define PF_W       0x2  /* Write */
 #define PF_R       0x4  /* Read */
 
-/* Load and execute an ELF binary from memory */
-int elf_load_and_exec(uint8_t *elf_data, uint32_t size);
+/* A PT_LOAD segment inside the user window */
+#define ELF_MAX_SEGMENTS 8
+
+typedef struct {
+    uint32_t vaddr;
+    uint32_t memsz;
+    uint32_t filesz;
+    uint32_t offset;
+    uint32_t flags;             /* PF_* */
+} elf_segment_t;
+
+/* A resolved load-time fixup: the word at addr is patched with value
+ * as its R_386_* type says (symbols are looked up once, at load) */
+typedef struct {
+    uint32_t addr;              /* Loaded address */
+    uint32_t type;
+    uint32_t value;             /* Load bias or symbol address */
+} elf_reloc_t;
+
+/* Load-time relocations of a position-independent (ET_DYN) program */
+typedef struct {
+    uint32_t bias;              /* Load address minus link address */
+    elf_reloc_t *entries;       /* Sorted by address */
+    uint32_t count;
+} elf_relocs_t;
+
+/* Directory searched first for programs given by bare name */
+#define EXEC_PATH  "/bin"
+
+/* Open a program for exec, returns NULL if not found */
+vfs_file_t *elf_open(const char *name);
+
+/* Read exactly len bytes at offset of file, 0 or -1 */
+int elf_read_at(vfs_file_t *file, uint32_t offset, void *buf, uint32_t len);
+
+/* File offset of the len bytes at loaded address addr, or -1 if they
+ * are not all backed by the file */
+int32_t elf_file_offset(const elf_segment_t *segs, int count, uint32_t addr, uint32_t len);
+
+/* elf_load_and_exec errors, also returned by the exec syscall */
+#define ELF_ERR_READ    -3  /* I/O error reading the headers */
+#define ELF_ERR_FORMAT  -4  /* Not an i386 ELF executable */
+#define ELF_ERR_LOAD    -5  /* Bad segments or out of resources */
+
+/* Read and validate the headers of file and cache the resulting image,
+ * with its segments inside [base, limit) (position-independent images
+ * are placed at base). Returns 0 with a referenced image in *out and the
+ * DYNAMIC header (PT_NULL if none) in *dynamic, or an ELF_ERR_* code. */
+struct exec_image;
+int elf_read_image(vfs_file_t *file, uint32_t base, uint32_t limit,
+                   struct exec_image **out, elf32_phdr_t *dynamic);
+
+/* Run an ELF binary as process `name` in a new address space. Only the
+ * headers are read up front; pages are filled from `file` on first
+ * touch, and the loader closes it when done. Returns 0 once the program
+ * exits, or an ELF_ERR_* code. */
+int elf_load_and_exec(const char *name, vfs_file_t *file);
+
+/* Start an ELF binary as a separate, scheduled process that runs
+ * alongside the caller. Takes ownership of file and of args (kmalloc'd,
+ * NULL for none) on success. Returns the child's pid or an ELF_ERR_* code. */
+int elf_spawn(const char *name, vfs_file_t *file, program_args_t *args);
+
+/* Page fault hook: map the missing user page at addr for the running
+ * program; esp is its user stack pointer, for stack growth. Returns 0 if
+ * the fault was resolved. */
+int elf_page_fault(uint32_t addr, uint32_t err_code, uint32_t esp);
+
+/* Nonzero while a userspace program is running */
+int elf_running(void);
 
 /* Validate ELF header */
 int elf_validate_header(elf32_ehdr_t *header);
 
-/* Return from userspace to kernel (called by exit syscall) */
-void elf_return_to_kernel(void);
+/* Return from userspace to kernel (called by exit syscall). Exec'd
+ * programs resume their caller; others end with the exit code. */
+void elf_return_to_kernel(int code);
 
 #endif /* ELF_H */
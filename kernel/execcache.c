@@ -0,0 +1,215 @@
+#include "execcache.h"
+#include "pmm.h"
+#include "heap.h"
+
+static exec_image_t *head = 0;      /* Most recently used */
+static exec_image_t *tail = 0;
+static uint32_t idle_count = 0;     /* Cached images nobody is running */
+static execcache_stats_t stats;
+
+static void copy_page(uint32_t dst, uint32_t src) {
+    uint32_t *d = (uint32_t *)dst;
+    const uint32_t *s = (const uint32_t *)src;
+    for (int i = 0; i < 1024; i++) {
+        d[i] = s[i];
+    }
+}
+
+static void list_remove(exec_image_t *img) {
+    if (img->prev) {
+        img->prev->next = img->next;
+    } else {
+        head = img->next;
+    }
+    if (img->next) {
+        img->next->prev = img->prev;
+    } else {
+        tail = img->prev;
+    }
+    img->prev = 0;
+    img->next = 0;
+    stats.images--;
+}
+
+static void list_push(exec_image_t *img) {
+    img->prev = 0;
+    img->next = head;
+    if (head) {
+        head->prev = img;
+    } else {
+        tail = img;
+    }
+    head = img;
+    stats.images++;
+}
+
+static void image_free(exec_image_t *img) {
+    for (uint32_t i = 0; i < img->num_pages; i++) {
+        if (img->frames[i]) {
+            pmm_free(img->frames[i]);
+            stats.pages--;
+            stats.bytes -= PAGE_SIZE;
+        }
+    }
+    stats.bytes -= sizeof(exec_image_t) + img->num_pages * sizeof(uint32_t) +
+                   img->relocs.count * sizeof(elf_reloc_t);
+    if (img->relocs.entries) {
+        kfree(img->relocs.entries);
+    }
+    kfree(img->frames);
+    kfree(img);
+}
+
+/* Drop the least recently used idle image, returns 0 if there is none */
+static int evict_one(void) {
+    for (exec_image_t *img = tail; img; img = img->prev) {
+        if (img->refcount == 0) {
+            list_remove(img);
+            idle_count--;
+            image_free(img);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+exec_image_t *execcache_lookup(vnode_t *vn) {
+    for (exec_image_t *img = head; img; img = img->next) {
+        if (img->mount == vn->mount && img->ino == vn->ino) {
+            if (img->refcount++ == 0) {
+                idle_count--;
+            }
+            list_remove(img);
+            list_push(img);
+            stats.hits++;
+            return img;
+        }
+    }
+    stats.misses++;
+    return 0;
+}
+
+exec_image_t *execcache_insert(vnode_t *vn, uint32_t entry,
+                               const elf_segment_t *segs, int count,
+                               const elf_relocs_t *relocs) {
+    if (count == 0) {
+        return 0;
+    }
+
+    uint32_t base = 0xFFFFFFFF;
+    uint32_t end = 0;
+
+    for (int i = 0; i < count; i++) {
+        uint32_t lo = segs[i].vaddr & 0xFFFFF000;
+        uint32_t hi = segs[i].vaddr + segs[i].memsz;
+        if (lo < base) base = lo;
+        if (hi > end) end = hi;
+    }
+
+    exec_image_t *img = (exec_image_t *)kmalloc(sizeof(exec_image_t));
+    if (!img) {
+        return 0;
+    }
+    img->num_pages = (end - base + PAGE_SIZE - 1) / PAGE_SIZE;
+    img->frames = (uint32_t *)kmalloc(img->num_pages * sizeof(uint32_t));
+    if (!img->frames) {
+        kfree(img);
+        return 0;
+    }
+
+    img->mount = vn->mount;
+    img->ino = vn->ino;
+    img->entry = entry;
+    img->relocs = *relocs;
+    img->needs_lib = 0;
+    img->count = count;
+    for (int i = 0; i < count; i++) {
+        img->segs[i] = segs[i];
+    }
+    img->base = base;
+    for (uint32_t i = 0; i < img->num_pages; i++) {
+        img->frames[i] = 0;
+    }
+    img->refcount = 1;
+    img->stale = 0;
+    stats.bytes += sizeof(exec_image_t) + img->num_pages * sizeof(uint32_t) +
+                   img->relocs.count * sizeof(elf_reloc_t);
+
+    list_push(img);
+    return img;
+}
+
+void execcache_get(exec_image_t *img) {
+    img->refcount++;
+}
+
+void execcache_put(exec_image_t *img) {
+    if (--img->refcount > 0) {
+        return;
+    }
+    if (img->stale) {
+        image_free(img);
+        return;
+    }
+
+    idle_count++;
+    while (idle_count > EXECCACHE_IMAGES && evict_one()) { }
+}
+
+uint32_t execcache_page(exec_image_t *img, uint32_t page) {
+    if (page < img->base || page - img->base >= img->num_pages * PAGE_SIZE) {
+        return 0;
+    }
+    return img->frames[(page - img->base) / PAGE_SIZE];
+}
+
+void execcache_store(exec_image_t *img, uint32_t page, uint32_t frame, int shared) {
+    if (img->stale || page < img->base || page - img->base >= img->num_pages * PAGE_SIZE) {
+        return;
+    }
+    uint32_t *slot = &img->frames[(page - img->base) / PAGE_SIZE];
+    if (*slot) {
+        return;
+    }
+
+    /* Make room by dropping idle images, never the ones in use */
+    while (stats.pages >= EXECCACHE_PAGES && evict_one()) { }
+    if (stats.pages >= EXECCACHE_PAGES) {
+        return;
+    }
+
+    if (shared) {
+        if (pmm_ref(frame) != 0) {
+            return;
+        }
+        *slot = frame;
+    } else {
+        uint32_t copy = pmm_alloc();
+        if (!copy) {
+            return;
+        }
+        copy_page(copy, frame);
+        *slot = copy;
+    }
+    stats.pages++;
+    stats.bytes += PAGE_SIZE;
+}
+
+void execcache_invalidate(vfs_mount_t *mnt, uint32_t ino) {
+    for (exec_image_t *img = head; img; img = img->next) {
+        if (img->mount == mnt && img->ino == ino) {
+            list_remove(img);
+            if (img->refcount == 0) {
+                idle_count--;
+                image_free(img);
+            } else {
+                img->stale = 1;  /* Running programs keep their pages */
+            }
+            return;
+        }
+    }
+}
+
+void execcache_get_stats(execcache_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,72 @@
+#ifndef EXECCACHE_H
+#define EXECCACHE_H
+
+#include <stdint.h>
+#include "vfs.h"
+#include "elf.h"
+
+/*
+ * Exec image cache: validated program headers plus the prepared contents
+ * of every file-backed page, for recently executed binaries. Images are
+ * keyed by (mount, ino) and dropped when the file is written, truncated
+ * or unlinked. A repeat launch that hits the cache reads nothing from
+ * the file. Read-only pages are not copied at all: every instance maps
+ * the cached frame itself, held through PMM reference counts.
+ */
+
+#define EXECCACHE_IMAGES  8     /* Idle images kept */
+#define EXECCACHE_PAGES   256   /* Prepared pages kept across all images (1MB) */
+
+typedef struct exec_image {
+    vfs_mount_t *mount;
+    uint32_t ino;
+    uint32_t entry;
+    elf_relocs_t relocs;        /* Applied as pages are prepared */
+    int count;
+    elf_segment_t segs[ELF_MAX_SEGMENTS];
+    uint32_t base;              /* First page any segment touches */
+    uint32_t num_pages;
+    uint32_t *frames;           /* Prepared page contents, 0 until first filled */
+    uint32_t refcount;          /* Running programs using the image */
+    uint8_t needs_lib;          /* Linked against the resident library */
+    uint8_t stale;              /* File changed: freed on last put */
+    struct exec_image *prev;    /* Cached images, most recently used first */
+    struct exec_image *next;
+} exec_image_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t images;            /* Images in the cache */
+    uint32_t pages;             /* Prepared pages held */
+    uint32_t bytes;             /* Total memory: pages plus bookkeeping */
+} execcache_stats_t;
+
+/* Take a reference on the cached image of a file, or NULL on a miss */
+exec_image_t *execcache_lookup(vnode_t *vn);
+
+/* Cache a freshly validated image and take a reference, NULL if out of
+ * memory. The image takes over relocs->addrs on success. */
+exec_image_t *execcache_insert(vnode_t *vn, uint32_t entry,
+                               const elf_segment_t *segs, int count,
+                               const elf_relocs_t *relocs);
+
+/* Take another reference on an image already in use (fork) */
+void execcache_get(exec_image_t *img);
+
+/* Drop a reference taken by lookup, insert or get */
+void execcache_put(exec_image_t *img);
+
+/* Prepared contents of the page at virtual address page, 0 if not yet cached */
+uint32_t execcache_page(exec_image_t *img, uint32_t page);
+
+/* Keep a freshly filled page (best effort, within the page budget). A
+ * shared frame is kept by reference, otherwise a private copy is made. */
+void execcache_store(exec_image_t *img, uint32_t page, uint32_t frame, int shared);
+
+/* Forget the image of a file that is about to change */
+void execcache_invalidate(vfs_mount_t *mnt, uint32_t ino);
+
+void execcache_get_stats(execcache_stats_t *stats);
+
+#endif /* EXECCACHE_H */
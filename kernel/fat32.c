@@ -1,6 +1,9 @@
 #include "fat32.h"
 #include "ide.h"
 #include "vga.h"
+#include "pmm.h"
+#include "pagecache.h"
+#include "heap.h"
 
 /* Global filesystem state */
 static fat32_fs_t fs;
@@ -8,6 +11,10 @@ static fat32_fs_t fs;
 /* Sector buffer */
 static uint16_t sector_buffer[256];  /* 512 bytes */
 
+/* Last FAT sector read; a contiguous chain walks 128 clusters per sector */
+static uint32_t fat_cache[FAT32_SECTOR_SIZE / 4];
+static uint32_t fat_cache_sector = 0;  /* 0 = empty (sector 0 is the boot sector) */
+
 /* Memory functions */
 static void* memcpy(void* dest, const void* src, uint32_t n) {
     uint8_t* d = (uint8_t*)dest;
@@ -43,13 +50,17 @@ static uint32_t fat32_get_next_cluster(uint32_t cluster) {
     uint32_t fat_sector = fs.fat_start_sector + (fat_offset / FAT32_SECTOR_SIZE);
     uint32_t entry_offset = (fat_offset % FAT32_SECTOR_SIZE) / 4;
 
-    /* Read FAT sector */
-    if (ide_read_sectors(fs.drive, fat_sector, 1, sector_buffer) != 0) {
-        return FAT32_CLUSTER_EOC;
+    /* Read FAT sector unless it is the one already cached */
+    if (fat_sector != fat_cache_sector) {
+        if (ide_read_sectors(fs.drive, fat_sector, 1, (uint16_t *)fat_cache) != 0) {
+            fat_cache_sector = 0;
+            return FAT32_CLUSTER_EOC;
+        }
+        fat_cache_sector = fat_sector;
     }
 
     /* Get next cluster */
-    uint32_t next_cluster = ((uint32_t*)sector_buffer)[entry_offset] & FAT32_CLUSTER_MASK;
+    uint32_t next_cluster = fat_cache[entry_offset] & FAT32_CLUSTER_MASK;
 
     if (next_cluster >= FAT32_CLUSTER_EOC) {
         return FAT32_CLUSTER_EOC;
@@ -70,6 +81,7 @@ static uint32_t fat32_cluster_to_sector(uint32_t cluster) {
 int fat32_init(uint8_t drive) {
     fs.drive = drive;
     fs.initialized = 0;
+    fat_cache_sector = 0;
 
     /* Read boot sector */
     if (ide_read_sectors(drive, 0, 1, sector_buffer) != 0) {
@@ -257,7 +269,7 @@ int fat32_list_root(void) {
 }
 
 /* Get directory listing */
-int fat32_list_dir(fat32_dirinfo_t *entries, int max_entries) {
+int fat32_list_dir(vfs_dirent_t *entries, int max_entries) {
     if (!fs.initialized || !entries || max_entries <= 0) {
         return -1;
     }
@@ -316,12 +328,10 @@ int fat32_list_dir(fat32_dirinfo_t *entries, int max_entries) {
     return entry_count;
 }
 
-/* Open a file */
-fat32_file_t* fat32_open(const char *filename) {
-    static fat32_file_t file;
-
+/* Find a root directory entry by name, copying it to *out */
+static int fat32_find(const char *filename, fat32_direntry_t *out) {
     if (!fs.initialized) {
-        return NULL;
+        return -1;
     }
 
     uint8_t search_name[11];
@@ -334,7 +344,7 @@ fat32_file_t* fat32_open(const char *filename) {
 
         for (uint32_t i = 0; i < fs.bpb.sectors_per_cluster; i++) {
             if (ide_read_sectors(fs.drive, sector + i, 1, sector_buffer) != 0) {
-                return NULL;
+                return -1;
             }
 
             fat32_direntry_t *entries = (fat32_direntry_t *)sector_buffer;
@@ -343,7 +353,7 @@ fat32_file_t* fat32_open(const char *filename) {
                 fat32_direntry_t *entry = &entries[j];
 
                 if (entry->name[0] == 0x00) {
-                    return NULL;  /* File not found */
+                    return -1;  /* File not found */
                 }
 
                 if (entry->name[0] == 0xE5) {
@@ -355,15 +365,8 @@ fat32_file_t* fat32_open(const char *filename) {
                 }
 
                 if (strncmp((char*)entry->name, (char*)search_name, 11) == 0) {
-                    /* Found it! */
-                    file.first_cluster = ((uint32_t)entry->first_cluster_high << 16) |
-                                        entry->first_cluster_low;
-                    file.current_cluster = file.first_cluster;
-                    file.size = entry->file_size;
-                    file.position = 0;
-                    file.attr = entry->attr;
-                    file.valid = 1;
-                    return &file;
+                    memcpy(out, entry, sizeof(fat32_direntry_t));
+                    return 0;
                 }
             }
         }
@@ -371,10 +374,160 @@ fat32_file_t* fat32_open(const char *filename) {
         cluster = fat32_get_next_cluster(cluster);
     }
 
-    return NULL;  /* File not found */
+    return -1;  /* File not found */
+}
+
+/* Allocate a handle for the file starting at first_cluster */
+static fat32_file_t *fat32_new_handle(uint32_t first_cluster, uint32_t size, uint8_t attr) {
+    fat32_file_t *file = (fat32_file_t *)kmalloc(sizeof(fat32_file_t));
+    if (!file) {
+        return NULL;
+    }
+    file->first_cluster = first_cluster;
+    file->current_cluster = first_cluster;
+    file->cluster_index = 0;
+    file->size = size;
+    file->position = 0;
+    file->advice = FADV_NORMAL;
+    file->ra_window = 0;
+    file->ra_next = 0;
+    file->ra_end = 0;
+    file->attr = attr;
+    file->valid = 1;
+    return file;
+}
+
+/* Open a file */
+fat32_file_t* fat32_open(const char *filename) {
+    fat32_direntry_t entry;
+    if (fat32_find(filename, &entry) != 0) {
+        return NULL;
+    }
+    return fat32_new_handle(((uint32_t)entry.first_cluster_high << 16) | entry.first_cluster_low,
+                            entry.file_size, entry.attr);
+}
+
+static uint32_t fat32_seek_cluster(fat32_file_t *file, uint32_t idx) {
+    if (idx < file->cluster_index) {
+        file->current_cluster = file->first_cluster;
+        file->cluster_index = 0;
+    }
+
+    while (file->cluster_index < idx && file->current_cluster < FAT32_CLUSTER_EOC) {
+        file->current_cluster = fat32_get_next_cluster(file->current_cluster);
+        file->cluster_index++;
+    }
+
+    return file->current_cluster;
+}
+
+/* Page cache fill: read one 4KB page of a file straight from disk */
+static int fat32_fill_page(void *ctx, uint32_t index, uint8_t *page) {
+    fat32_file_t *file = (fat32_file_t *)ctx;
+    uint32_t cluster_size = fs.bpb.sectors_per_cluster * FAT32_SECTOR_SIZE;
+    uint32_t offset = index * PAGE_SIZE;
+    uint32_t want = file->size - offset;
+    uint32_t filled = 0;
+
+    if (want > PAGE_SIZE) {
+        want = PAGE_SIZE;
+    }
+
+    uint32_t cluster = fat32_seek_cluster(file, offset / cluster_size);
+    uint32_t offset_in_cluster = offset % cluster_size;
+
+    while (filled < want) {
+        if (cluster < 2 || cluster >= FAT32_CLUSTER_EOC) {
+            return -1;
+        }
+
+        /* Extend the read over physically contiguous clusters */
+        uint32_t needed = (want - filled + FAT32_SECTOR_SIZE - 1) / FAT32_SECTOR_SIZE;
+        uint32_t sectors = (cluster_size - offset_in_cluster) / FAT32_SECTOR_SIZE;
+        uint32_t sector = fat32_cluster_to_sector(cluster) +
+                         (offset_in_cluster / FAT32_SECTOR_SIZE);
+
+        while (sectors < needed) {
+            uint32_t next = fat32_seek_cluster(file, file->cluster_index + 1);
+            if (next != cluster + 1) {
+                break;
+            }
+            cluster = next;
+            sectors += fs.bpb.sectors_per_cluster;
+        }
+        if (sectors > needed) {
+            sectors = needed;
+        }
+
+        if (ide_read_sectors(fs.drive, sector, (uint8_t)sectors,
+                             (uint16_t *)(page + filled)) != 0) {
+            return -1;
+        }
+
+        filled += sectors * FAT32_SECTOR_SIZE;
+        offset_in_cluster = 0;
+
+        /* The cursor already sits on the first cluster of the next run */
+        cluster = file->current_cluster;
+    }
+
+    /* Zero the tail past EOF so the page can be mapped as-is */
+    memset(page + want, 0, PAGE_SIZE - want);
+    return 0;
 }
 
-/* Read from file */
+/* Bring pages [first, first + count) of a file into the page cache */
+static void fat32_prefetch(fat32_file_t *file, uint32_t first, uint32_t count) {
+    uint32_t dev = FAT32_DEV(fs.drive);
+    uint32_t pages = (file->size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    for (uint32_t index = first; index < pages && index - first < count; index++) {
+        if (pagecache_lookup(dev, file->first_cluster, index)) {
+            continue;
+        }
+        if (!pagecache_get(dev, file->first_cluster, index, fat32_fill_page, file)) {
+            return;
+        }
+        pagecache_put(dev, file->first_cluster, index);
+    }
+}
+
+/* Update the readahead window after a read of page `index` and prefetch */
+static void fat32_readahead(fat32_file_t *file, uint32_t index) {
+    if (file->advice == FADV_RANDOM) {
+        return;
+    }
+
+    if (file->advice == FADV_SEQUENTIAL) {
+        file->ra_window = FAT32_READAHEAD_MAX;
+    } else if (index == file->ra_next) {
+        /* Still sequential: double the window */
+        if (file->ra_window == 0) {
+            file->ra_window = 1;
+        } else if (file->ra_window < FAT32_READAHEAD_MAX) {
+            file->ra_window *= 2;
+        }
+    } else if (index + 1 != file->ra_next) {
+        file->ra_window = 0;
+    }
+    file->ra_next = index + 1;
+
+    if (file->ra_window == 0) {
+        return;
+    }
+
+    uint32_t start = index + 1;
+    uint32_t end = index + 1 + file->ra_window;
+    if (file->ra_end > start && file->ra_end <= end) {
+        start = file->ra_end;  /* Already prefetched up to here */
+    }
+    if (start < end) {
+        fat32_prefetch(file, start, end - start);
+        file->ra_end = end;
+    }
+}
+
+/* Read from file (through the page cache) */
 int fat32_read(fat32_file_t *file, uint8_t *buffer, uint32_t size) {
     if (!file || !file->valid || !fs.initialized) {
         return -1;
@@ -388,50 +541,78 @@ int fat32_read(fat32_file_t *file, uint8_t *buffer, uint32_t size) {
         bytes_to_read = file->size - file->position;
     }
 
-    while (bytes_to_read > 0 && file->current_cluster < FAT32_CLUSTER_EOC) {
-        uint32_t cluster_size = fs.bpb.sectors_per_cluster * FAT32_SECTOR_SIZE;
-        uint32_t offset_in_cluster = file->position % cluster_size;
-        uint32_t bytes_in_cluster = cluster_size - offset_in_cluster;
+    while (bytes_to_read > 0) {
+        uint32_t index = file->position / PAGE_SIZE;
+        uint32_t offset_in_page = file->position % PAGE_SIZE;
+        uint32_t chunk = PAGE_SIZE - offset_in_page;
 
-        if (bytes_in_cluster > bytes_to_read) {
-            bytes_in_cluster = bytes_to_read;
+        if (chunk > bytes_to_read) {
+            chunk = bytes_to_read;
         }
 
-        /* Read sector(s) */
-        uint32_t sector = fat32_cluster_to_sector(file->current_cluster) +
-                         (offset_in_cluster / FAT32_SECTOR_SIZE);
-        uint32_t offset_in_sector = offset_in_cluster % FAT32_SECTOR_SIZE;
-
-        if (ide_read_sectors(fs.drive, sector, 1, sector_buffer) != 0) {
+        uint32_t frame = pagecache_get(FAT32_DEV(fs.drive), file->first_cluster,
+                                       index, fat32_fill_page, file);
+        if (!frame) {
             return bytes_read;
         }
 
-        /* Copy data */
-        uint32_t bytes_in_sector = FAT32_SECTOR_SIZE - offset_in_sector;
-        if (bytes_in_sector > bytes_in_cluster) {
-            bytes_in_sector = bytes_in_cluster;
+        memcpy(buffer, (uint8_t *)frame + offset_in_page, chunk);
+        pagecache_put(FAT32_DEV(fs.drive), file->first_cluster, index);
+
+        if (offset_in_page == 0 || bytes_read == 0) {
+            fat32_readahead(file, index);
         }
 
-        memcpy(buffer, (uint8_t*)sector_buffer + offset_in_sector, bytes_in_sector);
+        buffer += chunk;
+        bytes_read += chunk;
+        bytes_to_read -= chunk;
+        file->position += chunk;
+    }
 
-        buffer += bytes_in_sector;
-        bytes_read += bytes_in_sector;
-        bytes_to_read -= bytes_in_sector;
-        file->position += bytes_in_sector;
+    return bytes_read;
+}
 
-        /* Move to next cluster if needed */
-        if ((file->position % cluster_size) == 0) {
-            file->current_cluster = fat32_get_next_cluster(file->current_cluster);
-        }
+/* Hint the access pattern for a byte range */
+int fat32_advise(fat32_file_t *file, uint32_t offset, uint32_t len, int advice) {
+    if (!file || !file->valid || !fs.initialized) {
+        return -1;
     }
 
-    return bytes_read;
+    /* Clamp the range to whole pages within the file */
+    if (len == 0 || offset + len > file->size || offset + len < offset) {
+        len = file->size > offset ? file->size - offset : 0;
+    }
+    uint32_t first = offset / PAGE_SIZE;
+    uint32_t count = (offset + len + PAGE_SIZE - 1) / PAGE_SIZE - first;
+
+    switch (advice) {
+        case FADV_NORMAL:
+        case FADV_RANDOM:
+        case FADV_SEQUENTIAL:
+            file->advice = (uint8_t)advice;
+            file->ra_window = 0;
+            file->ra_end = 0;
+            return 0;
+
+        case FADV_WILLNEED:
+            fat32_prefetch(file, first, count);
+            return 0;
+
+        case FADV_DONTNEED:
+            pagecache_invalidate_range(FAT32_DEV(fs.drive), file->first_cluster, first, count);
+            file->ra_end = 0;
+            return 0;
+
+        default:
+            return -1;
+    }
 }
 
-/* Close file */
+/* Close file and free its handle */
 void fat32_close(fat32_file_t *file) {
     if (file) {
         file->valid = 0;
+        kfree(file);
     }
 }
 
@@ -445,3 +626,63 @@ void fat32_get_info(uint32_t *total_sectors, uint32_t *free_clusters) {
         *free_clusters = 0;  /* Would need to scan entire FAT */
     }
 }
+
+/* VFS glue: the volume is mounted read-only; vnode ino is the first cluster */
+static int fat32_vfs_lookup(vfs_mount_t *mnt, const char *name, vnode_t *vn) {
+    (void)mnt;
+    fat32_direntry_t entry;
+    if (fat32_find(name, &entry) != 0) {
+        return -1;
+    }
+    vn->ino = ((uint32_t)entry.first_cluster_high << 16) | entry.first_cluster_low;
+    vn->size = entry.file_size;
+    vn->is_directory = (entry.attr & FAT32_ATTR_DIRECTORY) ? 1 : 0;
+    return 0;
+}
+
+static void *fat32_vfs_open(vnode_t *vn, uint32_t flags) {
+    (void)flags;
+    return fat32_new_handle(vn->ino, vn->size,
+                            vn->is_directory ? FAT32_ATTR_DIRECTORY : 0);
+}
+
+static int fat32_vfs_read(vfs_file_t *file, uint8_t *buffer, uint32_t size) {
+    return fat32_read((fat32_file_t *)file->handle, buffer, size);
+}
+
+static int fat32_vfs_seek(vfs_file_t *file, uint32_t offset) {
+    ((fat32_file_t *)file->handle)->position = offset;
+    return 0;
+}
+
+static uint32_t fat32_vfs_tell(vfs_file_t *file) {
+    return ((fat32_file_t *)file->handle)->position;
+}
+
+static int fat32_vfs_advise(vfs_file_t *file, uint32_t offset, uint32_t len, int advice) {
+    return fat32_advise((fat32_file_t *)file->handle, offset, len, advice);
+}
+
+static void fat32_vfs_close(vfs_file_t *file) {
+    fat32_close((fat32_file_t *)file->handle);
+}
+
+static int fat32_vfs_readdir(vfs_mount_t *mnt, vfs_dirent_t *entries, int max_entries) {
+    (void)mnt;
+    return fat32_list_dir(entries, max_entries);
+}
+
+const vfs_ops_t fat32_ops = {
+    .name = "fat32",
+    .lookup = fat32_vfs_lookup,
+    .create = NULL,
+    .open = fat32_vfs_open,
+    .read = fat32_vfs_read,
+    .write = NULL,
+    .seek = fat32_vfs_seek,
+    .tell = fat32_vfs_tell,
+    .advise = fat32_vfs_advise,
+    .close = fat32_vfs_close,
+    .unlink = NULL,
+    .readdir = fat32_vfs_readdir,
+};
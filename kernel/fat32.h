@@ -2,6 +2,7 @@
 #define FAT32_H
 
 #include <stdint.h>
+#include "vfs.h"
 
 /* FAT32 Filesystem Driver */
 
@@ -83,23 +84,27 @@ typedef struct {
     uint8_t initialized;
 } fat32_fs_t;
 
+/* Largest readahead window, in pages */
+#define FAT32_READAHEAD_MAX 16
+
+/* Page cache device number for a FAT32 volume on an IDE drive */
+#define FAT32_DEV(drive) (0x0300 | (drive))
+
 /* File handle */
 typedef struct {
-    uint32_t first_cluster;
-    uint32_t current_cluster;
+    uint32_t first_cluster;         /* Also the file's page cache inode number */
+    uint32_t current_cluster;       /* Cluster cursor used when filling pages */
+    uint32_t cluster_index;         /* Position of current_cluster in the chain */
     uint32_t size;
     uint32_t position;
     uint8_t attr;
     uint8_t valid;
+    uint8_t advice;                 /* FADV_NORMAL/RANDOM/SEQUENTIAL */
+    uint8_t ra_window;              /* Current readahead window in pages */
+    uint32_t ra_next;               /* Page a sequential reader asks for next */
+    uint32_t ra_end;                /* First page not yet prefetched */
 } fat32_file_t;
 
-/* Directory entry info for userspace */
-typedef struct {
-    char name[13];        /* Filename in readable format */
-    uint32_t size;        /* File size in bytes */
-    uint8_t is_directory; /* 1 if directory, 0 if file */
-} fat32_dirinfo_t;
-
 /* Initialize FAT32 filesystem */
 int fat32_init(uint8_t drive);
 
@@ -112,6 +117,9 @@ fat32_file_t* fat32_open(const char *filename);
 /* Read from file */
 int fat32_read(fat32_file_t *file, uint8_t *buffer, uint32_t size);
 
+/* Hint the access pattern for a byte range (len 0 = to EOF) */
+int fat32_advise(fat32_file_t *file, uint32_t offset, uint32_t len, int advice);
+
 /* Close file */
 void fat32_close(fat32_file_t *file);
 
@@ -119,6 +127,9 @@ void fat32_close(fat32_file_t *file);
 void fat32_get_info(uint32_t *total_sectors, uint32_t *free_clusters);
 
 /* Get directory listing */
-int fat32_list_dir(fat32_dirinfo_t *entries, int max_entries);
+int fat32_list_dir(vfs_dirent_t *entries, int max_entries);
+
+/* VFS operations for the volume (mount with VFS_CASEFOLD) */
+extern const vfs_ops_t fat32_ops;
 
 #endif /* FAT32_H */
@@ -0,0 +1,74 @@
+#include "file.h"
+
+/* Descriptor table of the running process */
+static vfs_file_t **file_table(void) {
+    process_t *cur = process_get_current();
+    return cur ? cur->files : 0;
+}
+
+/* Look up an open descriptor */
+static vfs_file_t *file_get(int fd) {
+    vfs_file_t **files = file_table();
+    if (!files || fd < 0 || fd >= MAX_OPEN_FILES) {
+        return 0;
+    }
+    return files[fd];
+}
+
+int file_open(const char *filename, uint32_t flags) {
+    vfs_file_t **files = file_table();
+    if (!filename || !files) {
+        return -1;
+    }
+
+    /* Find a free descriptor */
+    int fd;
+    for (fd = 0; fd < MAX_OPEN_FILES; fd++) {
+        if (!files[fd]) {
+            break;
+        }
+    }
+    if (fd == MAX_OPEN_FILES) {
+        return -1;
+    }
+
+    files[fd] = vfs_open(filename, flags);
+    return files[fd] ? fd : -1;
+}
+
+int file_read(int fd, uint8_t *buffer, uint32_t size) {
+    return vfs_read(file_get(fd), buffer, size);
+}
+
+int file_write(int fd, const uint8_t *buffer, uint32_t size) {
+    return vfs_write(file_get(fd), buffer, size);
+}
+
+int file_close(int fd) {
+    vfs_file_t *file = file_get(fd);
+    if (!file) {
+        return -1;
+    }
+    vfs_close(file);
+    file_table()[fd] = 0;
+    return 0;
+}
+
+int file_advise(int fd, uint32_t offset, uint32_t len, int advice) {
+    return vfs_advise(file_get(fd), offset, len, advice);
+}
+
+void file_inherit(process_t *child, process_t *parent) {
+    for (int fd = 0; fd < MAX_OPEN_FILES; fd++) {
+        child->files[fd] = parent ? vfs_dup(parent->files[fd]) : 0;
+    }
+}
+
+void file_close_all(process_t *p) {
+    for (int fd = 0; fd < MAX_OPEN_FILES; fd++) {
+        if (p->files[fd]) {
+            vfs_close(p->files[fd]);
+            p->files[fd] = 0;
+        }
+    }
+}
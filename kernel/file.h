@@ -0,0 +1,39 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include <stdint.h>
+#include "vfs.h"
+#include "process.h"
+
+/*
+ * Open file tables: small integer descriptors for userspace, each
+ * referring to an open VFS file. Every process has its own table
+ * (process_t.files, MAX_OPEN_FILES entries); the calls below work on
+ * the current one.
+ */
+
+/* Open a file by path (O_CREAT/O_TRUNC from vfs.h), returns fd or -1 */
+int file_open(const char *filename, uint32_t flags);
+
+/* Read up to size bytes, returns bytes read or -1 */
+int file_read(int fd, uint8_t *buffer, uint32_t size);
+
+/* Write size bytes, returns bytes written or -1 (read-only filesystems) */
+int file_write(int fd, const uint8_t *buffer, uint32_t size);
+
+/* Close a descriptor, returns 0 or -1 */
+int file_close(int fd);
+
+/* Hint the access pattern for a byte range (FADV_* in vfs.h) */
+int file_advise(int fd, uint32_t offset, uint32_t len, int advice);
+
+/* Give child a copy of every descriptor parent has open (fork, spawn,
+ * exec). Each copy starts at the parent's file position and moves on
+ * its own from there; one that cannot be made for lack of memory is
+ * left closed in the child. */
+void file_inherit(process_t *child, process_t *parent);
+
+/* Close all of a process's descriptors (when it exits) */
+void file_close_all(process_t *p);
+
+#endif /* FILE_H */
@@ -1,4 +1,5 @@
 #include "gdt.h"
+#include "pmm.h"
 
 /* GDT entry */
 struct gdt_entry {
@@ -43,7 +44,7 @@ void gdt_init(void) {
 
     /* Set TSS kernel stack */
     tss.ss0 = GDT_KERNEL_DATA;
-    tss.esp0 = 0x1F0000;
+    tss.esp0 = PHYS_TO_VIRT(KERNEL_STACK_TOP);
     tss.iomap_base = sizeof(tss);
 
     /* Null descriptor */
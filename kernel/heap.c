@@ -47,17 +47,17 @@ static void coalesce_forward(block_header_t *block) {
     }
 }
 
-/* Add a new page from PMM to the heap */
-static block_header_t *heap_add_page(void) {
-    uint32_t page = pmm_alloc();
+/* Add count contiguous pages from the PMM to the heap as one block */
+static block_header_t *heap_add_pages(uint32_t count) {
+    uint32_t page = pmm_alloc_pages(count);
     if (page == 0)
         return (void *)0;
 
     block_header_t *block = (block_header_t *)page;
-    block->size = PAGE_SIZE - HEADER_SIZE;
+    block->size = count * PAGE_SIZE - HEADER_SIZE;
     block->is_free = 1;
     block->next = (void *)0;
-    heap_pages++;
+    heap_pages += count;
 
     list_insert(block);
 
@@ -73,7 +73,7 @@ static block_header_t *heap_add_page(void) {
 
 void heap_init(void) {
     for (int i = 0; i < INITIAL_PAGES; i++) {
-        heap_add_page();
+        heap_add_pages(1);
     }
 }
 
@@ -116,12 +116,9 @@ void *kmalloc(uint32_t size) {
         cur = cur->next;
     }
 
-    /* No block found — try to grow the heap */
-    uint32_t pages_needed = (size + HEADER_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
-    for (uint32_t i = 0; i < pages_needed; i++) {
-        if (!heap_add_page())
-            return (void *)0;
-    }
+    /* No block found — grow the heap by one contiguous block big enough */
+    if (!heap_add_pages((size + HEADER_SIZE + PAGE_SIZE - 1) / PAGE_SIZE))
+        return (void *)0;
 
     /* Retry */
     cur = free_list;
@@ -4,6 +4,8 @@
 #include "keyboard.h"
 #include "syscall.h"
 #include "process.h"
+#include "elf.h"
+#include "paging.h"
 
 /* IDT table and pointer */
 static struct idt_entry idt[IDT_ENTRIES];
@@ -12,6 +14,9 @@ static struct idt_ptr idtp;
 /* PIT tick counter */
 volatile uint32_t pit_ticks = 0;
 
+/* A time slice ran out and the switch is still owed */
+static int resched_pending = 0;
+
 /* ISR stub declarations from isr.asm */
 extern void isr0(void);  extern void isr1(void);  extern void isr2(void);
 extern void isr3(void);  extern void isr4(void);  extern void isr5(void);
@@ -104,6 +109,16 @@ static void pit_init(void) {
 }
 
 /* C interrupt dispatcher — called from isr_common_stub */
+/* User stack pointer when a page fault hit: from the fault frame in ring 3,
+ * from the syscall in progress when the kernel touched user memory */
+static uint32_t fault_user_esp(struct isr_regs *regs) {
+    if (regs->err_code & 0x4) {
+        return regs->useresp;
+    }
+    process_t *cur = process_get_current();
+    return (cur && cur->frame) ? cur->frame->useresp : USER_STACK_TOP;
+}
+
 void isr_handler(struct isr_regs *regs) {
     if (regs->int_no < 32) {
         /* Page Fault — show detailed diagnostics */
@@ -111,6 +126,16 @@ void isr_handler(struct isr_regs *regs) {
             uint32_t faulting_addr;
             __asm__ volatile("mov %%cr2, %0" : "=r"(faulting_addr));
 
+            /* Copy-on-write after fork: first write to a shared page */
+            if ((regs->err_code & 0x3) == 0x3 && paging_cow_fault(faulting_addr) == 0) {
+                return;
+            }
+
+            /* Demand paging: first touch of a program page */
+            if (elf_page_fault(faulting_addr, regs->err_code, fault_user_esp(regs)) == 0) {
+                return;
+            }
+
             vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
             vga_puts("\n*** PAGE FAULT ***\n");
             vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
@@ -126,6 +151,16 @@ void isr_handler(struct isr_regs *regs) {
             vga_puts((regs->err_code & 0x4) ? "User-mode" : "Kernel-mode");
             vga_puts("\n");
 
+            /* A bad user access kills the program, not the machine */
+            if (elf_running() && ((regs->err_code & 0x4) ||
+                                  (faulting_addr >= USER_BASE && faulting_addr < USER_STACK_TOP))) {
+                vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+                vga_puts("Segmentation fault\n");
+                vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+                __asm__ volatile("sti");
+                elf_return_to_kernel(-1);
+            }
+
             vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
             vga_puts("System halted.\n");
             __asm__ volatile("cli; hlt");
@@ -151,9 +186,12 @@ void isr_handler(struct isr_regs *regs) {
 
     /* Syscall: int 0x80 */
     if (regs->int_no == 128) {
+        /* fork copies this frame for the child */
+        process_get_current()->frame = regs;
+
         /* Re-enable interrupts (int gate clears IF) so timer/keyboard work */
         __asm__ volatile("sti");
-        regs->eax = syscall_handler(regs->eax, regs->ebx, regs->ecx, regs->edx);
+        regs->eax = syscall_handler(regs->eax, regs->ebx, regs->ecx, regs->edx, regs->esi);
         return;
     }
 
@@ -161,8 +199,17 @@ void isr_handler(struct isr_regs *regs) {
         /* IRQ0: PIT timer tick */
         pit_ticks++;
 
-        /* Schedule every 10 ticks (100ms time slice) */
-        if (pit_ticks % 10 == 0) {
+        /* Schedule every 10 ticks (100ms time slice). Kernel data has no
+         * locks, so a process inside a syscall or fault is never switched
+         * out here (it yields where it waits); only kernel threads are,
+         * not PID 0, which runs the kernel shell. */
+        if (pit_ticks % 10 == 0)
+            resched_pending = 1;
+        process_t *cur = process_get_current();
+        if (resched_pending && ((regs->cs & 3) == 3 ||
+                                (cur && cur->pid != 0 &&
+                                 cur->page_directory == (uint32_t)kernel_page_directory))) {
+            resched_pending = 0;
             /* Send EOI before switching so timer keeps firing */
             outb(0x20, 0x20);
             schedule();
@@ -76,6 +76,8 @@ ISR_NOERRCODE 47    ; IRQ15 - Secondary ATA
 ; Syscall interrupt (int 0x80)
 ISR_NOERRCODE 128   ; Syscall
 
+global isr_return
+
 ; Common stub: saves state, calls C handler, restores and irets
 isr_common_stub:
     pusha               ; Save EAX, ECX, EDX, EBX, ESP, EBP, ESI, EDI
@@ -93,6 +95,9 @@ isr_common_stub:
     call isr_handler
     add esp, 4          ; Clean up argument
 
+; Forked processes start here, on a copy of their parent's syscall frame
+isr_return:
+
     pop eax             ; Restore data segment
     mov ds, ax
     mov es, ax
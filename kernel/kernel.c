@@ -2,6 +2,7 @@
 #include "serial.h"
 #include "ide.h"
 #include "fat32.h"
+#include "vfs.h"
 #include "elf.h"
 #include "syscall.h"
 #include "keyboard.h"
@@ -12,19 +13,20 @@
 #include "heap.h"
 #include "paging.h"
 #include "process.h"
+#include "pagecache.h"
+#include "tmpfs.h"
+#include "crofs.h"
 
 /* Feature flags */
 #define PRINT_HELLO_TXT      0
 #define ENABLE_HELLO_BINARY  0
 #define TEST_KERNEL_THREADS  0
+#define SYS_RAMDISK          1  /* Copy the /bin image into memory at boot */
 
 /* Shell command buffer */
 static char shell_cmd_buf[64];
 static int shell_cmd_pos = 0;
 
-/* Binary buffer for loading programs (global to avoid stack issues) */
-static uint8_t binary_buffer[65536];
-
 /* Execute a command by loading and running a binary from the filesystem */
 static void execute_command(const char *cmd) {
     char program_name[64];
@@ -32,62 +34,26 @@ static void execute_command(const char *cmd) {
     /* Parse command line into program and arguments */
     parse_command_line(cmd, program_name, &current_program_args);
 
-    /* Convert program name to uppercase for FAT32 8.3 filename */
-    char filename[12];
-    int i;
-    for (i = 0; program_name[i] && i < 11; i++) {
-        char ch = program_name[i];
-        if (ch >= 'a' && ch <= 'z') {
-            filename[i] = ch - 32;
-        } else {
-            filename[i] = ch;
-        }
-    }
-    filename[i] = '\0';
-
     /* Try to open the file */
-    fat32_file_t *file = fat32_open(filename);
+    vfs_file_t *file = elf_open(program_name);
     if (file) {
-        if (file->size > 0 && file->size <= sizeof(binary_buffer)) {
-            int bytes_read = fat32_read(file, binary_buffer, file->size);
-            fat32_close(file);
-
-            if (bytes_read > 0) {
-                /* Check if it's an ELF file */
-                if (binary_buffer[0] == 0x7f &&
-                    binary_buffer[1] == 'E' &&
-                    binary_buffer[2] == 'L' &&
-                    binary_buffer[3] == 'F') {
-
-                    syscall_init();
-                    if (elf_load_and_exec(binary_buffer, bytes_read) != 0) {
-                        vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
-                        vga_puts("Failed to execute binary\n");
-                        serial_puts(SERIAL_COM1, "Failed to execute binary\r\n");
-                    }
-                } else {
-                    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
-                    vga_puts("Not an ELF binary\n");
-                    serial_puts(SERIAL_COM1, "Not an ELF binary\r\n");
-                }
-            } else {
-                vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
-                vga_puts("Failed to read file\n");
-                serial_puts(SERIAL_COM1, "Failed to read file\r\n");
-            }
-        } else {
-            fat32_close(file);
+        syscall_init();
+        int result = elf_load_and_exec(program_name, file);
+        if (result != 0) {
+            const char *msg = result == ELF_ERR_FORMAT ? "Not an ELF binary\n" :
+                              result == ELF_ERR_READ ? "Failed to read file\n" :
+                              "Failed to execute binary\n";
             vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
-            vga_puts("File too large\n");
-            serial_puts(SERIAL_COM1, "File too large\r\n");
+            vga_puts(msg);
+            serial_puts(SERIAL_COM1, msg);
         }
     } else {
         vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
         vga_puts("Command not found: ");
-        vga_puts(filename);
+        vga_puts(program_name);
         vga_putchar('\n');
         serial_puts(SERIAL_COM1, "Command not found: ");
-        serial_puts(SERIAL_COM1, filename);
+        serial_puts(SERIAL_COM1, program_name);
         serial_puts(SERIAL_COM1, "\r\n");
     }
 }
@@ -117,8 +83,9 @@ static void thread_b(void) {
 }
 #endif
 
-/* Kernel main function */
-void kernel_main(void) {
+/* Kernel main function; e820_map is the physical address of the BIOS
+ * memory map the bootloader collected (0 = none) */
+void kernel_main(uint32_t e820_map) {
     /* Initialize VGA */
     vga_init();
 
@@ -148,7 +115,7 @@ void kernel_main(void) {
     vga_puts("IDT/Interrupts: OK\n");
 
     /* Initialize physical memory manager */
-    pmm_init();
+    pmm_init(e820_map ? (const e820_map_t *)PHYS_TO_VIRT(e820_map) : 0);
     vga_puts("PMM: ");
     vga_puthex(pmm_get_free_count() * 4);
     vga_puts(" KB free (");
@@ -165,7 +132,16 @@ void kernel_main(void) {
         vga_puts(" KB free\n");
     }
 
-    /* Initialize paging (identity-mapped 0-16MB) */
+    /* Initialize page cache (reclaims frames when the PMM runs dry) */
+    pagecache_init();
+    vga_puts("Page cache: OK\n");
+
+    /* Mount tmpfs at /tmp, capped at a quarter of lowmem (its pages live there) */
+    tmpfs_init(pmm_get_low_count() / 4);
+    vfs_mount("/tmp", &tmpfs_ops, 0, 0);
+    vga_puts("tmpfs: mounted at /tmp\n");
+
+    /* Initialize paging (kernel in the top 1GB, 0-3GB left to programs) */
     paging_init();
     vga_puts("Paging: OK\n");
 
@@ -215,6 +191,7 @@ void kernel_main(void) {
 
     vga_puts("FAT32: ");
     if (fat32_init(0) == 0) {
+        vfs_mount("/", &fat32_ops, 0, VFS_CASEFOLD);
         vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
         vga_puts("OK\n\n");
         vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
@@ -273,49 +250,27 @@ void kernel_main(void) {
         vga_puts("Loading HELLO binary...\n");
         vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
 
-        fat32_file_t *bin_file = fat32_open("HELLO");
+        vfs_file_t *bin_file = vfs_open("HELLO", 0);
         if (bin_file) {
             vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
             vga_puts("Binary found! Size: ");
-            vga_puthex(bin_file->size);
+            vga_puthex(bin_file->vnode->size);
             vga_puts(" bytes\n");
             vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
 
-            /* Allocate buffer for binary (max 64KB) */
-            static uint8_t binary_buffer[65536];
+            /* Initialize syscalls */
+            syscall_init();
 
-            if (bin_file->size > sizeof(binary_buffer)) {
-                vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-                vga_puts("Binary too large!\n");
+            /* Load and execute ELF binary (closes bin_file) */
+            if (elf_load_and_exec("HELLO", bin_file) == 0) {
+                vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+                vga_puts("\nBinary execution successful!\n");
                 vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
             } else {
-                /* Read entire binary */
-                int bytes_read = fat32_read(bin_file, binary_buffer, bin_file->size);
-
-                if (bytes_read > 0) {
-                    vga_puts("Binary loaded. ");
-
-                    /* Initialize syscalls */
-                    syscall_init();
-
-                    /* Load and execute ELF binary */
-                    if (elf_load_and_exec(binary_buffer, bytes_read) == 0) {
-                        vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
-                        vga_puts("\nBinary execution successful!\n");
-                        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-                    } else {
-                        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-                        vga_puts("Failed to execute binary\n");
-                        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-                    }
-                } else {
-                    vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-                    vga_puts("Failed to read binary\n");
-                    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-                }
+                vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+                vga_puts("Failed to execute binary\n");
+                vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
             }
-
-            fat32_close(bin_file);
         } else {
             vga_set_color(VGA_COLOR_YELLOW, VGA_COLOR_BLACK);
             vga_puts("Binary not found (add HELLO file to disk)\n");
@@ -331,6 +286,14 @@ void kernel_main(void) {
         vga_puts("(Disk may not be formatted as FAT32)\n\n");
     }
 
+    /* System binaries: compressed image on the slave drive, mounted at /bin */
+    crofs_t *sys = crofs_open(IDE_DRIVE_SLAVE, SYS_RAMDISK);
+    if (sys) {
+        vfs_mount(EXEC_PATH, &crofs_ops, sys, VFS_CASEFOLD);
+        vga_puts("crofs: mounted at " EXEC_PATH);
+        vga_puts(sys->frames ? " (RAM disk)\n\n" : "\n\n");
+    }
+
     vga_set_color(VGA_COLOR_YELLOW, VGA_COLOR_BLACK);
     vga_puts("System ready.\n");
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
@@ -341,11 +304,13 @@ void kernel_main(void) {
     process_create("thread_a", (uint32_t)thread_a);
     process_create("thread_b", (uint32_t)thread_b);
 
-    /* PID 0 loops as a kernel thread too */
+    /* PID 0 loops too, handing over the CPU itself (the timer never
+     * preempts it) */
     while (1) {
         vga_set_color(VGA_COLOR_YELLOW, VGA_COLOR_BLACK);
         vga_puts("[K]");
         busy_wait();
+        process_yield();
     }
 #endif
 
@@ -4,21 +4,114 @@
 [BITS 32]
 [EXTERN kernel_main]  ; Declare C function
 
+KERNEL_BASE equ 0xC0000000
+KERNEL_PDE  equ KERNEL_BASE >> 22
+
 global _start
 _start:
-    ; Segments should already be set up by bootloader
-    ; But let's make sure stack is correct
-    mov ebp, 0x1F0000
-    mov esp, ebp
+    ; Linked at KERNEL_BASE but running at its physical address: until
+    ; paging is on, every absolute address must have KERNEL_BASE taken off.
+    ; EBX = physical address of the E820 memory map (boot.asm); kept for
+    ; kernel_main, so nothing below may touch it.
 
     ; Disable interrupts (we have no IDT)
     cli
 
+%ifdef CONFIG_PAE
+    ; Clear the two boot page directories and the PDPT after them (.bss
+    ; is not loaded, so not zeroed)
+    mov edi, boot_pd_low - KERNEL_BASE
+    mov ecx, 3 * 1024
+    xor eax, eax
+    rep stosd
+
+    ; Map physical 0-1GB at KERNEL_BASE with 2MB pages (PDPT entry 3),
+    ; and the first 16MB at 0 (entry 0) so the next few instructions keep
+    ; running
+    mov edi, boot_pd_low - KERNEL_BASE
+    mov eax, 0x83           ; Present | Writable | 2MB page
+    xor ecx, ecx
+.map_low:
+    mov [edi + ecx * 8], eax
+    add eax, 0x200000
+    inc ecx
+    cmp ecx, 8
+    jne .map_low
+
+    mov edi, boot_pd_high - KERNEL_BASE
+    mov eax, 0x83
+    xor ecx, ecx
+.map_high:
+    mov [edi + ecx * 8], eax
+    add eax, 0x200000
+    inc ecx
+    cmp ecx, 512
+    jne .map_high
+
+    ; PDPT entries take the Present bit only
+    mov edi, boot_pdpt - KERNEL_BASE
+    mov dword [edi], boot_pd_low - KERNEL_BASE + 1
+    mov dword [edi + 3 * 8], boot_pd_high - KERNEL_BASE + 1
+
+    ; Enable PAE (CR4.PAE), load the PDPT and turn paging on
+    mov eax, cr4
+    or eax, 0x20
+    mov cr4, eax
+    mov cr3, edi
+    mov eax, cr0
+    or eax, 0x80000000
+    mov cr0, eax
+%else
+    ; Clear the boot page directory (.bss is not loaded, so not zeroed)
+    mov edi, boot_page_directory - KERNEL_BASE
+    mov ecx, 1024
+    xor eax, eax
+    rep stosd
+
+    ; Map physical 0-1GB at KERNEL_BASE with 4MB pages, where the kernel
+    ; lives (the PMM may put its arrays anywhere in RAM), and the first
+    ; 16MB at 0 as well so the next few instructions keep running
+    mov edi, boot_page_directory - KERNEL_BASE
+    mov eax, 0x83           ; Present | Writable | 4MB page
+    xor ecx, ecx
+.map:
+    cmp ecx, 4
+    jae .high_only
+    mov [edi + ecx * 4], eax
+.high_only:
+    mov [edi + KERNEL_PDE * 4 + ecx * 4], eax
+    add eax, 0x400000
+    inc ecx
+    cmp ecx, 1024 - KERNEL_PDE
+    jne .map
+
+    ; Enable 4MB pages (CR4.PSE), load the directory and turn paging on
+    mov eax, cr4
+    or eax, 0x10
+    mov cr4, eax
+    mov cr3, edi
+    mov eax, cr0
+    or eax, 0x80000000
+    mov cr0, eax
+
+%endif
+
+    ; Jump to the higher half (absolute, not relative)
+    mov eax, .higher_half
+    jmp eax
+
+.higher_half:
+    ; Segments should already be set up by bootloader
+    ; But let's make sure stack is correct
+    mov ebp, KERNEL_BASE + 0x1F0000
+    mov esp, ebp
+
     ; Write test message to VGA
-    mov edi, 0xB8000
+    mov edi, KERNEL_BASE + 0xB8000
     mov eax, 0x0F540F4B  ; 'KT' in white
     mov [edi], eax
 
+    push ebx          ; kernel_main(e820_map)
     call kernel_main  ; Call C kernel
 
     ; Hang forever
@@ -26,3 +119,18 @@ _start:
     hlt
 .hang:
     jmp .hang
+
+; Page directory used until paging_init builds the real one
+section .bss
+align 4096
+%ifdef CONFIG_PAE
+boot_pd_low:
+    resb 4096
+boot_pd_high:
+    resb 4096
+boot_pdpt:                  ; Only 32 bytes used; 4096 keeps the layout simple
+    resb 4096
+%else
+boot_page_directory:
+    resb 4096
+%endif
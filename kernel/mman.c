@@ -0,0 +1,138 @@
+#include "mman.h"
+#include "paging.h"
+#include "pmm.h"
+#include "execcache.h"
+#include "vga.h"
+
+#define PAGE_UP(addr) (((addr) + PAGE_SIZE - 1) & 0xFFFFF000)
+
+/* End of the window free for heap and mappings */
+static uint32_t window_end(process_t *p) {
+    return (p->image && p->image->needs_lib) ? USER_LIB_BASE : USER_STACK_GUARD;
+}
+
+void mman_init(process_t *p, uint32_t image_end) {
+    p->heap_start = PAGE_UP(image_end);
+    p->brk = p->heap_start;
+}
+
+uint32_t mman_brk(uint32_t addr) {
+    process_t *p = process_get_current();
+    if (!p || !p->image) {
+        return 0;
+    }
+    if (addr < p->heap_start || addr > window_end(p)) {
+        return p->brk;
+    }
+
+    uint32_t *dir = current_page_directory;
+    uint32_t old_end = PAGE_UP(p->brk);
+    uint32_t new_end = PAGE_UP(addr);
+
+    /* Growing: every new page must still be free, else undo */
+    for (uint32_t page = old_end; page < new_end; page += PAGE_SIZE) {
+        if (paging_reserve_user(dir, page) != 0) {
+            while (page > old_end) {
+                page -= PAGE_SIZE;
+                paging_unmap_user(dir, page);
+            }
+            return p->brk;
+        }
+    }
+    /* Shrinking: pages above the new break are freed */
+    for (uint32_t page = new_end; page < old_end; page += PAGE_SIZE) {
+        paging_unmap_user(dir, page);
+    }
+
+    p->brk = addr;
+    return addr;
+}
+
+uint32_t mman_map(uint32_t len) {
+    process_t *p = process_get_current();
+    if (!p || !p->image || len == 0 || len > USER_STACK_GUARD - USER_BASE) {
+        return 0;
+    }
+
+    uint32_t *dir = current_page_directory;
+    uint32_t pages = PAGE_UP(len) / PAGE_SIZE;
+    uint32_t floor = PAGE_UP(p->brk);
+    uint32_t run = 0;
+
+    /* Highest run of free pages above the break */
+    for (uint32_t page = window_end(p); page > floor; ) {
+        page -= PAGE_SIZE;
+        if (paging_user_entry(dir, page) != 0) {
+            run = 0;
+            continue;
+        }
+        if (++run < pages) {
+            continue;
+        }
+        for (uint32_t i = 0; i < pages; i++) {
+            if (paging_reserve_user(dir, page + i * PAGE_SIZE) != 0) {
+                while (i-- > 0) {
+                    paging_unmap_user(dir, page + i * PAGE_SIZE);
+                }
+                return 0;
+            }
+        }
+        return page;
+    }
+    return 0;
+}
+
+int mman_unmap(uint32_t addr, uint32_t len) {
+    process_t *p = process_get_current();
+    if (!p || !p->image || (addr & 0xFFF) || len == 0 ||
+        addr < PAGE_UP(p->brk) || addr >= window_end(p) || len > window_end(p) - addr) {
+        return -1;
+    }
+
+    /* Only anonymous pages: the image, heap and stack stay */
+    uint32_t end = addr + PAGE_UP(len);
+    for (uint32_t page = addr; page < end; page += PAGE_SIZE) {
+        uint32_t pte = paging_user_entry(current_page_directory, page);
+        if (pte && !(pte & PAGE_ANON)) {
+            return -1;
+        }
+    }
+    for (uint32_t page = addr; page < end; page += PAGE_SIZE) {
+        paging_unmap_user(current_page_directory, page);
+    }
+    return 0;
+}
+
+/* Back page with a fresh zero frame */
+static int map_zero_page(uint32_t page, uint32_t flags) {
+    uint32_t pfn = pmm_alloc_user();
+    if (!pfn) {
+        return -1;
+    }
+    paging_zero_frame(pfn);
+
+    if (paging_map_user_pfn(current_page_directory, page, pfn, flags) != 0) {
+        pmm_free_pfn(pfn);
+        return -1;
+    }
+    return 0;
+}
+
+int mman_fault(uint32_t addr) {
+    uint32_t page = addr & 0xFFFFF000;
+    if (paging_user_entry(current_page_directory, page) != PAGE_ANON) {
+        return -1;
+    }
+    return map_zero_page(page, PAGE_WRITABLE | PAGE_ANON);
+}
+
+int mman_stack_fault(uint32_t addr, uint32_t esp) {
+    if (addr >= USER_STACK_GUARD && addr < USER_STACK_LIMIT) {
+        vga_puts("Stack overflow\n");
+        return -1;
+    }
+    if (addr < USER_STACK_LIMIT || addr >= USER_STACK_TOP || addr + STACK_SLACK < esp) {
+        return -1;
+    }
+    return map_zero_page(addr & 0xFFFFF000, PAGE_WRITABLE);
+}
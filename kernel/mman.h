@@ -0,0 +1,39 @@
+#ifndef MMAN_H
+#define MMAN_H
+
+#include <stdint.h>
+#include "process.h"
+
+#define STACK_SLACK  32     /* pusha stores 32 bytes below ESP */
+
+/*
+ * User heap, anonymous mappings and stack growth. The program break starts
+ * at the first page after the image and grows up; anonymous mappings are
+ * placed top-down from the end of the free window (the shared library or
+ * the stack guard page). Pages of either are only reserved (PAGE_ANON)
+ * until first touched, when a zero page is mapped in.
+ */
+
+/* Start an empty heap right after the image of a new program */
+void mman_init(process_t *p, uint32_t image_end);
+
+/* Move the break of the current process to addr (0 only queries). Returns
+ * the new break, or the old one if the pages are taken or out of range. */
+uint32_t mman_brk(uint32_t addr);
+
+/* Reserve len bytes of zero-filled memory, returns its address or 0 */
+uint32_t mman_map(uint32_t len);
+
+/* Drop anonymous pages in [addr, addr + len), returns 0 or -1 */
+int mman_unmap(uint32_t addr, uint32_t len);
+
+/* First touch of a reserved page: back it with a zero page. Returns 0,
+ * or -1 if the page is not reserved or memory ran out. */
+int mman_fault(uint32_t addr);
+
+/* Fault in the stack region: map a zero page there if addr is at most
+ * STACK_SLACK bytes below the user stack pointer esp. Returns 0, or -1 for
+ * the guard page, stray accesses and out of memory. */
+int mman_stack_fault(uint32_t addr, uint32_t esp);
+
+#endif /* MMAN_H */
@@ -0,0 +1,253 @@
+#include "pagecache.h"
+#include "pmm.h"
+#include "heap.h"
+#include "slab.h"
+
+#define FILE_HASH_SIZE  64      /* Buckets in the global (dev, ino) table */
+#define PAGE_HASH_SIZE  32      /* Buckets in each file's page table */
+
+typedef struct cache_file cache_file_t;
+
+/* One cached page of file data */
+typedef struct cache_page {
+    cache_file_t *file;
+    uint32_t index;                 /* Page index within the file */
+    uint32_t frame;                 /* Direct-map address of the data */
+    uint32_t referenced;            /* Clock bit, set on every hit */
+    uint32_t pins;                  /* Callers still copying from the frame */
+    struct cache_page *hash_next;   /* Next page in the file's bucket */
+    struct cache_page *clock_prev;  /* Clock ring of all cached pages */
+    struct cache_page *clock_next;
+} cache_page_t;
+
+/* Per-file index of cached pages */
+struct cache_file {
+    uint32_t dev;
+    uint32_t ino;
+    uint32_t num_pages;
+    cache_page_t *pages[PAGE_HASH_SIZE];
+    cache_file_t *next;             /* Next file in the global bucket */
+};
+
+static cache_file_t *file_table[FILE_HASH_SIZE];
+static cache_page_t *clock_hand = 0;
+static pagecache_stats_t stats;
+static slab_cache_t page_cache = SLAB_CACHE("cache_page", sizeof(cache_page_t), 0);
+
+static uint32_t file_hash(uint32_t dev, uint32_t ino) {
+    return (dev * 31 + ino) % FILE_HASH_SIZE;
+}
+
+static cache_file_t *find_file(uint32_t dev, uint32_t ino) {
+    cache_file_t *f = file_table[file_hash(dev, ino)];
+    while (f && (f->dev != dev || f->ino != ino))
+        f = f->next;
+    return f;
+}
+
+static cache_page_t *find_page(cache_file_t *file, uint32_t index) {
+    cache_page_t *p = file->pages[index % PAGE_HASH_SIZE];
+    while (p && p->index != index)
+        p = p->hash_next;
+    return p;
+}
+
+/* Insert just behind the hand, so a new page gets a full sweep before eviction */
+static void clock_insert(cache_page_t *page) {
+    if (!clock_hand) {
+        page->clock_prev = page;
+        page->clock_next = page;
+        clock_hand = page;
+        return;
+    }
+    page->clock_next = clock_hand;
+    page->clock_prev = clock_hand->clock_prev;
+    clock_hand->clock_prev->clock_next = page;
+    clock_hand->clock_prev = page;
+}
+
+static void clock_remove(cache_page_t *page) {
+    if (page->clock_next == page) {
+        clock_hand = 0;
+        return;
+    }
+    page->clock_prev->clock_next = page->clock_next;
+    page->clock_next->clock_prev = page->clock_prev;
+    if (clock_hand == page)
+        clock_hand = page->clock_next;
+}
+
+/* Unlink a page from its file and the clock, and release its frame */
+static void drop_page(cache_page_t *page) {
+    cache_file_t *file = page->file;
+
+    cache_page_t **link = &file->pages[page->index % PAGE_HASH_SIZE];
+    while (*link != page)
+        link = &(*link)->hash_next;
+    *link = page->hash_next;
+
+    clock_remove(page);
+    pmm_free(page->frame);
+    slab_free(&page_cache, page);
+    stats.pages--;
+
+    /* Forget files with no cached pages left */
+    if (--file->num_pages == 0) {
+        cache_file_t **flink = &file_table[file_hash(file->dev, file->ino)];
+        while (*flink != file)
+            flink = &(*flink)->next;
+        *flink = file->next;
+        kfree(file);
+        stats.files--;
+    }
+}
+
+void pagecache_init(void) {
+    for (int i = 0; i < FILE_HASH_SIZE; i++)
+        file_table[i] = 0;
+    clock_hand = 0;
+    stats.pages = 0;
+    stats.files = 0;
+    stats.hits = 0;
+    stats.misses = 0;
+    stats.evictions = 0;
+
+    pmm_set_reclaim_hook(pagecache_reclaim);
+}
+
+static cache_page_t *lookup_page(uint32_t dev, uint32_t ino, uint32_t index) {
+    cache_file_t *file = find_file(dev, ino);
+    return file ? find_page(file, index) : 0;
+}
+
+uint32_t pagecache_lookup(uint32_t dev, uint32_t ino, uint32_t index) {
+    cache_page_t *page = lookup_page(dev, ino, index);
+    if (!page)
+        return 0;
+    page->referenced = 1;
+    return page->frame;
+}
+
+uint32_t pagecache_get(uint32_t dev, uint32_t ino, uint32_t index,
+                       pagecache_fill_t fill, void *ctx) {
+    cache_page_t *page = lookup_page(dev, ino, index);
+    if (page) {
+        stats.hits++;
+        page->referenced = 1;
+        page->pins++;
+        return page->frame;
+    }
+    stats.misses++;
+
+    /*
+     * Allocate before touching the index: both calls can reclaim, which may
+     * free the very file entry we would otherwise be holding.
+     */
+    page = (cache_page_t *)slab_alloc(&page_cache);
+    if (!page)
+        return 0;
+    uint32_t frame = pmm_alloc();
+    if (!frame) {
+        slab_free(&page_cache, page);
+        return 0;
+    }
+
+    if (fill(ctx, index, (uint8_t *)frame) != 0) {
+        pmm_free(frame);
+        slab_free(&page_cache, page);
+        return 0;
+    }
+
+    cache_file_t *file = find_file(dev, ino);
+    if (!file) {
+        file = (cache_file_t *)kmalloc(sizeof(cache_file_t));
+        if (!file) {
+            pmm_free(frame);
+            slab_free(&page_cache, page);
+            return 0;
+        }
+        file->dev = dev;
+        file->ino = ino;
+        file->num_pages = 0;
+        for (int i = 0; i < PAGE_HASH_SIZE; i++)
+            file->pages[i] = 0;
+        uint32_t h = file_hash(dev, ino);
+        file->next = file_table[h];
+        file_table[h] = file;
+        stats.files++;
+    }
+
+    page->file = file;
+    page->index = index;
+    page->frame = frame;
+    page->referenced = 1;
+    page->pins = 1;
+    page->hash_next = file->pages[index % PAGE_HASH_SIZE];
+    file->pages[index % PAGE_HASH_SIZE] = page;
+    file->num_pages++;
+    clock_insert(page);
+    stats.pages++;
+
+    return frame;
+}
+
+void pagecache_put(uint32_t dev, uint32_t ino, uint32_t index) {
+    cache_page_t *page = lookup_page(dev, ino, index);
+    if (page && page->pins > 0)
+        page->pins--;
+}
+
+void pagecache_invalidate(uint32_t dev, uint32_t ino) {
+    pagecache_invalidate_range(dev, ino, 0, 0xFFFFFFFF);
+}
+
+void pagecache_invalidate_range(uint32_t dev, uint32_t ino, uint32_t first, uint32_t count) {
+    cache_file_t *file = find_file(dev, ino);
+    if (!file)
+        return;
+
+    /*
+     * drop_page frees the file along with its last page; counting visited
+     * pages stops the walk before it can touch the freed entry.
+     */
+    uint32_t remaining = file->num_pages;
+    for (int i = 0; i < PAGE_HASH_SIZE && remaining > 0; i++) {
+        cache_page_t *page = file->pages[i];
+        while (page && remaining > 0) {
+            cache_page_t *next = page->hash_next;
+            remaining--;
+            if (page->index - first < count)
+                drop_page(page);
+            page = next;
+        }
+    }
+}
+
+uint32_t pagecache_reclaim(uint32_t pages) {
+    uint32_t freed = 0;
+    uint32_t budget = stats.pages * 2;  /* At most two full sweeps */
+
+    while (freed < pages && clock_hand && budget-- > 0) {
+        cache_page_t *page = clock_hand;
+        clock_hand = page->clock_next;
+
+        /* Being copied from: the frame has to stay */
+        if (page->pins)
+            continue;
+
+        /* Recently used: give it a second chance */
+        if (page->referenced) {
+            page->referenced = 0;
+            continue;
+        }
+
+        drop_page(page);
+        stats.evictions++;
+        freed++;
+    }
+    return freed;
+}
+
+void pagecache_get_stats(pagecache_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,53 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <stdint.h>
+
+/*
+ * Page cache: 4KB pages of file data, indexed by (dev, ino, page index).
+ * Each cached file has its own page hash; all pages sit on one clock list
+ * that is swept when the PMM runs out of frames.
+ */
+
+/* Fill callback: read page `index` of the file into `page` (4KB, zero any
+ * bytes past EOF). Returns 0 on success. */
+typedef int (*pagecache_fill_t)(void *ctx, uint32_t index, uint8_t *page);
+
+/* Page cache statistics */
+typedef struct {
+    uint32_t pages;      /* Frames currently holding file data */
+    uint32_t files;      /* Files with at least one cached page */
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+} pagecache_stats_t;
+
+/* Initialize the page cache and register it as the PMM reclaim hook */
+void pagecache_init(void);
+
+/* Get the frame holding page `index` of (dev, ino), filling it via `fill`
+ * on a miss. Returns the frame (its direct-map address), or 0 on failure.
+ * The page is pinned (never reclaimed) until the matching pagecache_put,
+ * so the caller may fault or allocate while copying from it. */
+uint32_t pagecache_get(uint32_t dev, uint32_t ino, uint32_t index,
+                       pagecache_fill_t fill, void *ctx);
+
+/* Unpin a page returned by pagecache_get */
+void pagecache_put(uint32_t dev, uint32_t ino, uint32_t index);
+
+/* Get the frame for a page only if it is already cached (0 otherwise) */
+uint32_t pagecache_lookup(uint32_t dev, uint32_t ino, uint32_t index);
+
+/* Drop every cached page of a file (after modification) */
+void pagecache_invalidate(uint32_t dev, uint32_t ino);
+
+/* Drop cached pages [first, first + count) of a file */
+void pagecache_invalidate_range(uint32_t dev, uint32_t ino, uint32_t first, uint32_t count);
+
+/* Evict up to `pages` unreferenced pages with the clock algorithm.
+ * Returns the number of frames returned to the PMM. */
+uint32_t pagecache_reclaim(uint32_t pages);
+
+void pagecache_get_stats(pagecache_stats_t *stats);
+
+#endif /* PAGECACHE_H */
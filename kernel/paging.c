@@ -1,10 +1,47 @@
 #include "paging.h"
 #include "pmm.h"
 
-/* Number of page directory entries to identity-map (4 = 16MB) */
-#define IDENTITY_MAP_ENTRIES 4
+/*
+ * Table layout. Classic: CR3 -> page directory of 1024 32-bit entries,
+ * each mapping 4MB. PAE: CR3 -> 4-entry PDPT -> page directories of 512
+ * 64-bit entries, each mapping 2MB; page tables hold 512 entries and
+ * frames may sit anywhere below 64GB. Either way the kernel's directory
+ * entries (KERNEL_BASE up) are shared by every address space.
+ */
+#ifdef CONFIG_PAE
+typedef uint64_t pte_t;
+#define PTE_ENTRIES        512
+#define PDE_SHIFT          21
+#define PTE_ADDR_MASK      0x0000000FFFFFF000ULL
+#else
+typedef uint32_t pte_t;
+#define PTE_ENTRIES        1024
+#define PDE_SHIFT          22
+#define PTE_ADDR_MASK      0xFFFFF000
+#endif
+
+/* Bytes mapped by one directory entry */
+#define PDE_SPAN           (1u << PDE_SHIFT)
+
+#define PTE_INDEX(virt)    (((virt) >> 12) & (PTE_ENTRIES - 1))
+#define PTE_PFN(entry)     ((uint32_t)(((entry) & PTE_ADDR_MASK) >> 12))
+#define PFN_ENTRY(pfn)     ((pte_t)(pfn) << 12)
+
+/* Table behind a directory (or PDPT) entry; tables always sit in lowmem */
+#define PTE_TABLE(entry)   ((pte_t *)PHYS_TO_VIRT((uint32_t)((entry) & PTE_ADDR_MASK)))
+
+/* CR4.PGE: global kernel pages stay in the TLB across CR3 loads */
+#define CR4_PGE            0x80
+
+/* Slots of the KMAP_BASE window used to reach highmem frames */
+#define KMAP_SRC           0
+#define KMAP_DST           1
 
 uint32_t *kernel_page_directory = 0;
+uint32_t *current_page_directory = 0;
+
+/* Page table behind KMAP_BASE, shared by every address space */
+static pte_t *kmap_table = 0;
 
 /* Zero a 4KB page */
 static void zero_page(void *page) {
@@ -14,82 +51,382 @@ static void zero_page(void *page) {
     }
 }
 
+/* Directory entry covering virt in an address space (NULL if its page
+ * directory is missing) */
+static pte_t *pde_slot(uint32_t *dir, uint32_t virt) {
+#ifdef CONFIG_PAE
+    pte_t pdpte = ((pte_t *)dir)[virt >> 30];
+    if (!(pdpte & PAGE_PRESENT)) {
+        return 0;
+    }
+    return &PTE_TABLE(pdpte)[(virt >> PDE_SHIFT) & (PTE_ENTRIES - 1)];
+#else
+    return &((pte_t *)dir)[virt >> PDE_SHIFT];
+#endif
+}
+
+/* Kernel address of a frame: the direct map for lowmem, else the given
+ * KMAP_BASE slot. Only valid with interrupts off, until the slot is
+ * reused. */
+static void *frame_addr(uint32_t pfn, uint32_t slot) {
+    if (pfn < pmm_get_low_count()) {
+        return (void *)PHYS_TO_VIRT(pfn * PAGE_SIZE);
+    }
+    uint32_t virt = KMAP_BASE + slot * PAGE_SIZE;
+    kmap_table[slot] = PFN_ENTRY(pfn) | PAGE_PRESENT | PAGE_WRITABLE;
+    __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
+    return (void *)virt;
+}
+
+static uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static void irq_restore(uint32_t flags) {
+    if (flags & 0x200) {
+        __asm__ volatile("sti" : : : "memory");
+    }
+}
+
+void paging_zero_frame(uint32_t pfn) {
+    uint32_t irq = irq_save();
+    zero_page(frame_addr(pfn, KMAP_DST));
+    irq_restore(irq);
+}
+
+/* Copy a whole frame into another */
+static void copy_frame(uint32_t dst_pfn, uint32_t src_pfn) {
+    uint32_t irq = irq_save();
+    uint32_t *d = (uint32_t *)frame_addr(dst_pfn, KMAP_DST);
+    const uint32_t *s = (const uint32_t *)frame_addr(src_pfn, KMAP_SRC);
+    for (int i = 0; i < 1024; i++) {
+        d[i] = s[i];
+    }
+    irq_restore(irq);
+}
+
 void paging_init(void) {
-    /* Allocate and zero the page directory */
+    /* Allocate and zero the page directory (the PDPT with PAE) */
     kernel_page_directory = (uint32_t *)pmm_alloc();
     zero_page(kernel_page_directory);
+#ifdef CONFIG_PAE
+    /* The kernel's 1GB is one page directory behind PDPT entry 3 */
+    pte_t *kpd = (pte_t *)pmm_alloc();
+    zero_page(kpd);
+    ((pte_t *)kernel_page_directory)[3] = VIRT_TO_PHYS(kpd) | PAGE_PRESENT;
+#endif
 
-    /* Identity-map 0-16MB (4 page directory entries, 4 page tables) */
-    for (int i = 0; i < IDENTITY_MAP_ENTRIES; i++) {
-        uint32_t *pt = (uint32_t *)pmm_alloc();
-        zero_page(pt);
+    /* Direct-map lowmem at KERNEL_BASE with large pages (4MB, or 2MB with
+     * PAE; kernel_entry turned them on). The pages are global: every
+     * address space maps them the same way. */
+    uint32_t entries = (pmm_get_low_count() + PDE_SPAN / PAGE_SIZE - 1) / (PDE_SPAN / PAGE_SIZE);
+    for (uint32_t i = 0; i < entries; i++) {
+        *pde_slot(kernel_page_directory, KERNEL_BASE + i * PDE_SPAN) =
+            (pte_t)(i * PDE_SPAN) | PAGE_PRESENT | PAGE_WRITABLE | PAGE_LARGE | PAGE_GLOBAL;
+    }
 
-        /* Fill page table: each entry maps to its corresponding physical page */
-        for (int j = 0; j < 1024; j++) {
-            uint32_t phys = (i * 1024 + j) * PAGE_SIZE;
-            pt[j] = phys | PAGE_PRESENT | PAGE_WRITABLE;
-        }
+    /* Window for highmem frames the kernel has to fill or copy */
+    kmap_table = (pte_t *)pmm_alloc();
+    zero_page(kmap_table);
+    *pde_slot(kernel_page_directory, KMAP_BASE) =
+        VIRT_TO_PHYS(kmap_table) | PAGE_PRESENT | PAGE_WRITABLE;
 
-        kernel_page_directory[i] = (uint32_t)pt | PAGE_PRESENT | PAGE_WRITABLE;
-    }
+    /* Global pages must be enabled before the switch flushes the boot ones */
+    uint32_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_PGE;
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4));
 
-    /* Load page directory into CR3 */
-    __asm__ volatile("mov %0, %%cr3" : : "r"(kernel_page_directory));
+    /* Load page directory into CR3; the boot identity map is gone from here on */
+    paging_switch(kernel_page_directory);
 
-    /* Enable paging: set PG bit (bit 31) in CR0 */
+    /* Paging is already on (kernel_entry); set WP (bit 16) so the kernel
+     * cannot write through read-only (shared) user mappings either */
     uint32_t cr0;
     __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
-    cr0 |= 0x80000000;
+    cr0 |= 0x80010000;
     __asm__ volatile("mov %0, %%cr0" : : "r"(cr0));
 }
 
+uint32_t *paging_create_space(void) {
+    uint32_t *dir = (uint32_t *)pmm_alloc();
+    if (!dir) {
+        return 0;
+    }
+    zero_page(dir);
+
+#ifdef CONFIG_PAE
+    /* The CPU reads PDPT entries only when CR3 is loaded, so the three
+     * user page directories exist from the start; entry 3 is the kernel's */
+    pte_t *pdpt = (pte_t *)dir;
+    for (int i = 0; i < 3; i++) {
+        pte_t *pd = (pte_t *)pmm_alloc();
+        if (!pd) {
+            paging_destroy_space(dir);
+            return 0;
+        }
+        zero_page(pd);
+        pdpt[i] = VIRT_TO_PHYS(pd) | PAGE_PRESENT;
+    }
+    pdpt[3] = ((pte_t *)kernel_page_directory)[3];
+#else
+    /* Share the kernel's page tables; user tables come on demand */
+    for (int i = KERNEL_BASE >> PDE_SHIFT; i < PTE_ENTRIES; i++) {
+        dir[i] = kernel_page_directory[i];
+    }
+#endif
+
+    return dir;
+}
+
+void paging_destroy_space(uint32_t *dir) {
+    if (!dir || dir == kernel_page_directory) {
+        return;
+    }
+
+    /* Tables from KERNEL_BASE up are the shared kernel ones */
+    for (uint32_t virt = 0; virt < KERNEL_BASE; virt += PDE_SPAN) {
+        pte_t *pde = pde_slot(dir, virt);
+        if (!pde || !(*pde & PAGE_PRESENT)) {
+            continue;
+        }
+
+        pte_t *pt = PTE_TABLE(*pde);
+        for (int j = 0; j < PTE_ENTRIES; j++) {
+            if ((pt[j] & PAGE_PRESENT) && (pt[j] & PAGE_USER)) {
+                pmm_free_pfn(PTE_PFN(pt[j]));
+            }
+        }
+        pmm_free((uint32_t)pt);
+    }
+#ifdef CONFIG_PAE
+    for (int i = 0; i < 3; i++) {
+        if (((pte_t *)dir)[i] & PAGE_PRESENT) {
+            pmm_free((uint32_t)PTE_TABLE(((pte_t *)dir)[i]));
+        }
+    }
+#endif
+    pmm_free((uint32_t)dir);
+}
+
+uint32_t *paging_clone_space(uint32_t *src) {
+    uint32_t *dir = paging_create_space();
+    if (!dir) {
+        return 0;
+    }
+
+    for (uint32_t base = 0; base < KERNEL_BASE; base += PDE_SPAN) {
+        pte_t *pde = pde_slot(src, base);
+        if (!pde || !(*pde & PAGE_PRESENT)) {
+            continue;
+        }
+
+        pte_t *pt = PTE_TABLE(*pde);
+        for (int j = 0; j < PTE_ENTRIES; j++) {
+            pte_t pte = pt[j];
+            uint32_t virt = base + ((uint32_t)j << 12);
+            if (pte == PAGE_ANON) {
+                /* Reserved but never touched: the child gets its own zero page */
+                if (paging_reserve_user(dir, virt) != 0) {
+                    paging_destroy_space(dir);
+                    return 0;
+                }
+                continue;
+            }
+            if (!(pte & PAGE_PRESENT) || !(pte & PAGE_USER)) {
+                continue;
+            }
+
+            /* Writable pages turn copy-on-write in both spaces */
+            if (pte & PAGE_WRITABLE) {
+                pte = (pte & ~(pte_t)PAGE_WRITABLE) | PAGE_COW;
+                pt[j] = pte;
+            }
+            if (pmm_ref_pfn(PTE_PFN(pte)) != 0) {
+                paging_destroy_space(dir);
+                return 0;
+            }
+            if (paging_map_user_pfn(dir, virt, PTE_PFN(pte), (uint32_t)pte & 0xFFF) != 0) {
+                pmm_free_pfn(PTE_PFN(pte));
+                paging_destroy_space(dir);
+                return 0;
+            }
+        }
+    }
+
+    /* Drop the stale writable translations of the source */
+    if (src == current_page_directory) {
+        paging_switch(src);
+    }
+    return dir;
+}
+
+/* Entry for a user page, allocating its page table if create is set.
+ * NULL if virt is outside the user window or memory ran out. */
+static pte_t *user_pte(uint32_t *dir, uint32_t virt, int create) {
+    /* Shared kernel tables must never gain user pages */
+    if (virt < USER_BASE || virt >= USER_STACK_TOP) {
+        return 0;
+    }
+
+    pte_t *pde = pde_slot(dir, virt);
+    if (!pde) {
+        return 0;
+    }
+    if (!(*pde & PAGE_PRESENT)) {
+        if (!create) return 0;
+        pte_t *pt = (pte_t *)pmm_alloc();
+        if (!pt) return 0;
+        zero_page(pt);
+        *pde = VIRT_TO_PHYS(pt) | PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER;
+    }
+
+    return &PTE_TABLE(*pde)[PTE_INDEX(virt)];
+}
+
+int paging_cow_fault(uint32_t virt) {
+    pte_t *entry = user_pte(current_page_directory, virt, 0);
+    if (!entry || !(*entry & PAGE_PRESENT) || !(*entry & PAGE_COW)) {
+        return -1;
+    }
+
+    uint32_t pfn = PTE_PFN(*entry);
+    uint32_t flags = ((uint32_t)*entry & 0xFFF & ~PAGE_COW) | PAGE_WRITABLE;
+
+    /* Last user of the frame: just take it back */
+    if (pmm_ref_count_pfn(pfn) > 1) {
+        uint32_t copy = pmm_alloc_user();
+        if (!copy) {
+            return -1;
+        }
+        copy_frame(copy, pfn);
+        pmm_free_pfn(pfn);
+        pfn = copy;
+    }
+
+    *entry = PFN_ENTRY(pfn) | flags;
+    __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
+    return 0;
+}
+
+void paging_switch(uint32_t *dir) {
+    current_page_directory = dir;
+    __asm__ volatile("mov %0, %%cr3" : : "r"(VIRT_TO_PHYS(dir)) : "memory");
+}
+
+int paging_map_user_pfn(uint32_t *dir, uint32_t virt, uint32_t pfn, uint32_t flags) {
+    pte_t *pte = user_pte(dir, virt, 1);
+    if (!pte) {
+        return -1;
+    }
+    *pte = PFN_ENTRY(pfn) | (flags & 0xFFF) | PAGE_PRESENT | PAGE_USER;
+
+    if (dir == current_page_directory) {
+        __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
+    }
+    return 0;
+}
+
+int paging_map_user(uint32_t *dir, uint32_t virt, uint32_t frame, uint32_t flags) {
+    return paging_map_user_pfn(dir, virt, VIRT_TO_PHYS(frame) / PAGE_SIZE, flags);
+}
+
+int paging_reserve_user(uint32_t *dir, uint32_t virt) {
+    pte_t *pte = user_pte(dir, virt, 1);
+    if (!pte || *pte) {
+        return -1;
+    }
+    *pte = PAGE_ANON;
+    return 0;
+}
+
+void paging_unmap_user(uint32_t *dir, uint32_t virt) {
+    pte_t *pte = user_pte(dir, virt, 0);
+    if (!pte || !*pte) {
+        return;
+    }
+    if (*pte & PAGE_PRESENT) {
+        pmm_free_pfn(PTE_PFN(*pte));
+    }
+    *pte = 0;
+
+    if (dir == current_page_directory) {
+        __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
+    }
+}
+
+uint32_t paging_user_entry(uint32_t *dir, uint32_t virt) {
+    pte_t *pte = user_pte(dir, virt, 0);
+    return pte ? (uint32_t)*pte & 0xFFF : 0;
+}
+
 void paging_map(uint32_t virt, uint32_t phys, uint32_t flags) {
-    uint32_t pd_idx = PD_INDEX(virt);
-    uint32_t pt_idx = PT_INDEX(virt);
+    pte_t *pde = pde_slot(current_page_directory, virt);
+    if (!pde) return;
 
     /* Allocate page table if not present */
-    if (!(kernel_page_directory[pd_idx] & PAGE_PRESENT)) {
-        uint32_t *pt = (uint32_t *)pmm_alloc();
+    if (!(*pde & PAGE_PRESENT)) {
+        pte_t *pt = (pte_t *)pmm_alloc();
         if (!pt) return;
         zero_page(pt);
-        kernel_page_directory[pd_idx] = (uint32_t)pt | PAGE_PRESENT | PAGE_WRITABLE;
+        *pde = VIRT_TO_PHYS(pt) | PAGE_PRESENT | PAGE_WRITABLE;
+    } else if (*pde & PAGE_LARGE) {
+        return;  /* Direct map: not split into pages */
     }
 
     /* Propagate PAGE_USER to directory entry if needed */
     if (flags & PAGE_USER) {
-        kernel_page_directory[pd_idx] |= PAGE_USER;
+        *pde |= PAGE_USER;
     }
 
-    uint32_t *pt = (uint32_t *)PAGE_FRAME(kernel_page_directory[pd_idx]);
-    pt[pt_idx] = (phys & 0xFFFFF000) | (flags & 0xFFF) | PAGE_PRESENT;
+    pte_t *pt = PTE_TABLE(*pde);
+    pt[PTE_INDEX(virt)] = (phys & 0xFFFFF000) | (flags & 0xFFF) | PAGE_PRESENT;
 
     /* Invalidate TLB entry */
     __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
 }
 
 void paging_unmap(uint32_t virt) {
-    uint32_t pd_idx = PD_INDEX(virt);
-    uint32_t pt_idx = PT_INDEX(virt);
-
-    if (!(kernel_page_directory[pd_idx] & PAGE_PRESENT))
+    pte_t *pde = pde_slot(current_page_directory, virt);
+    if (!pde || !(*pde & PAGE_PRESENT) || (*pde & PAGE_LARGE))
         return;
 
-    uint32_t *pt = (uint32_t *)PAGE_FRAME(kernel_page_directory[pd_idx]);
-    pt[pt_idx] = 0;
+    pte_t *pt = PTE_TABLE(*pde);
+    pt[PTE_INDEX(virt)] = 0;
 
     __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
 }
 
 uint32_t paging_get_phys(uint32_t virt) {
-    uint32_t pd_idx = PD_INDEX(virt);
-    uint32_t pt_idx = PT_INDEX(virt);
-
-    if (!(kernel_page_directory[pd_idx] & PAGE_PRESENT))
+    pte_t *pde = pde_slot(current_page_directory, virt);
+    if (!pde || !(*pde & PAGE_PRESENT))
         return 0;
 
-    uint32_t *pt = (uint32_t *)PAGE_FRAME(kernel_page_directory[pd_idx]);
-    if (!(pt[pt_idx] & PAGE_PRESENT))
+    if (*pde & PAGE_LARGE)
+        return (uint32_t)(*pde & PTE_ADDR_MASK & ~(pte_t)(PDE_SPAN - 1)) + (virt & (PDE_SPAN - 1));
+
+    pte_t *pt = PTE_TABLE(*pde);
+    if (!(pt[PTE_INDEX(virt)] & PAGE_PRESENT))
         return 0;
 
-    return PAGE_FRAME(pt[pt_idx]) | (virt & 0xFFF);
+    return (uint32_t)(pt[PTE_INDEX(virt)] & PTE_ADDR_MASK) | (virt & 0xFFF);
+}
+
+int paging_user_range(uint32_t addr, uint32_t len) {
+    return addr >= USER_BASE && addr <= USER_STACK_TOP && len <= USER_STACK_TOP - addr;
+}
+
+int paging_user_string(const char *str) {
+    uint32_t addr = (uint32_t)str;
+    if (addr < USER_BASE) {
+        return 0;
+    }
+    for (; addr < USER_STACK_TOP; addr++) {
+        if (*(const char *)addr == '\0') {
+            return 1;
+        }
+    }
+    return 0;
 }
@@ -2,24 +2,95 @@
 #define PAGING_H
 
 #include <stdint.h>
+#include "pmm.h"
 
 /* Page table entry flags */
 #define PAGE_PRESENT    0x01
 #define PAGE_WRITABLE   0x02
 #define PAGE_USER       0x04
+#define PAGE_LARGE      0x80    /* Directory entry maps a 4MB page (2MB with PAE) */
+#define PAGE_GLOBAL     0x100   /* Kept in the TLB across CR3 loads (kernel only) */
+#define PAGE_COW        0x200   /* Available bit: read-only until copied on write */
+#define PAGE_ANON       0x400   /* Available bit: heap or anonymous mapping, zero-filled
+                                   on first touch (kept once present) */
 
-/* Extract page directory / page table indices from a virtual address */
-#define PD_INDEX(virt)    (((virt) >> 22) & 0x3FF)
-#define PT_INDEX(virt)    (((virt) >> 12) & 0x3FF)
-#define PAGE_FRAME(entry) ((entry) & 0xFFFFF000)
+/*
+ * User window: every address space has its own mappings from USER_BASE
+ * up to KERNEL_BASE (backed by PMM frames); the top 1GB is the shared
+ * kernel. The low 2MB stays unmapped to catch NULL pointers.
+ */
+#define USER_BASE         0x200000
+#ifndef USER_STACK_TOP
+#define USER_STACK_TOP    KERNEL_BASE   /* End of the window, page aligned */
+#endif
+#define USER_STACK_PAGE   (USER_STACK_TOP - PAGE_SIZE)
 
-/* Kernel page directory (physical = virtual under identity mapping) */
+/*
+ * The stack is reserved from USER_STACK_LIMIT up to the top and gains a
+ * page each time a fault lands in it near ESP. The page below is a guard
+ * that is never mapped, so runaway recursion kills the program.
+ */
+#ifndef USER_STACK_MAX
+#define USER_STACK_MAX    0x100000      /* 1MB */
+#endif
+#define USER_STACK_LIMIT  (USER_STACK_TOP - USER_STACK_MAX)
+#define USER_STACK_GUARD  (USER_STACK_LIMIT - PAGE_SIZE)
+
+/* Below the guard page: the resident shared library */
+#define USER_LIB_SIZE     0x10000
+#define USER_LIB_BASE     (USER_STACK_GUARD - USER_LIB_SIZE)
+
+/* Kernel page directory, or PDPT with PAE (direct-map address; CR3 gets
+ * VIRT_TO_PHYS of it). Entry sizes differ, so only paging.c looks inside. */
 extern uint32_t *kernel_page_directory;
 
-/* Initialize paging with identity mapping for 0-16MB */
+/* Page directory currently loaded in CR3 */
+extern uint32_t *current_page_directory;
+
+/* Take over from the boot page directory: lowmem mapped at KERNEL_BASE
+ * with global large pages, nothing mapped below */
 void paging_init(void);
 
-/* Map a virtual page to a physical page with given flags */
+/* Create an address space: kernel mappings shared, user window empty.
+ * Returns the page directory or NULL if out of memory. */
+uint32_t *paging_create_space(void);
+
+/* Free an address space together with its user frames and page tables */
+void paging_destroy_space(uint32_t *dir);
+
+/* Copy-on-write clone of an address space for fork: user pages are
+ * shared read-only by both. Returns the new directory or NULL. */
+uint32_t *paging_clone_space(uint32_t *src);
+
+/* Write fault on a present user page: give the current space its own
+ * copy if the page is copy-on-write. Returns 0 if resolved, -1 if not. */
+int paging_cow_fault(uint32_t virt);
+
+/* Load an address space into CR3 */
+void paging_switch(uint32_t *dir);
+
+/* Map a user page to a PMM frame (its direct-map address) in an address
+ * space, returns 0 or -1 */
+int paging_map_user(uint32_t *dir, uint32_t virt, uint32_t frame, uint32_t flags);
+
+/* Same, by page frame number (pmm_alloc_user frames, highmem included) */
+int paging_map_user_pfn(uint32_t *dir, uint32_t virt, uint32_t pfn, uint32_t flags);
+
+/* Zero a frame by page frame number, mapping it briefly if in highmem */
+void paging_zero_frame(uint32_t pfn);
+
+/* Reserve a free user page for an anonymous mapping without backing it:
+ * the entry holds PAGE_ANON only. Returns 0, or -1 if the page is in use. */
+int paging_reserve_user(uint32_t *dir, uint32_t virt);
+
+/* Drop a user page, backed or only reserved, freeing its frame */
+void paging_unmap_user(uint32_t *dir, uint32_t virt);
+
+/* Flag bits (low 12) of a user page's entry: 0 if it has none, PAGE_ANON
+ * if only reserved */
+uint32_t paging_user_entry(uint32_t *dir, uint32_t virt);
+
+/* Map a virtual page to a physical page with given flags (current space) */
 void paging_map(uint32_t virt, uint32_t phys, uint32_t flags);
 
 /* Unmap a virtual page */
@@ -28,4 +99,12 @@ void paging_unmap(uint32_t virt);
 /* Get the physical address mapped to a virtual address (0 if unmapped) */
 uint32_t paging_get_phys(uint32_t virt);
 
+/* Whether [addr, addr + len) lies inside the user window, so a pointer
+ * handed over by a program cannot reach the kernel half. Pages in the
+ * range may still be unmapped; touching them faults as usual. */
+int paging_user_range(uint32_t addr, uint32_t len);
+
+/* Whether a NUL-terminated string starts and ends inside the user window */
+int paging_user_string(const char *str);
+
 #endif /* PAGING_H */
@@ -1,72 +1,451 @@
 #include "pmm.h"
+#include "paging.h"
 
-/* Bitmap: 1 bit per page. 1 = used, 0 = free. */
-static uint8_t bitmap[TOTAL_PAGES / 8];
+/* Pages of RAM the PMM manages (up to the highest usable one); the first
+ * low_pages are lowmem and belong to the buddy allocator, the rest are
+ * highmem, allocated straight from the bitmap */
+static uint32_t total_pages = 0;
+static uint32_t low_pages = 0;
 
-#define BITMAP_SET(p)    (bitmap[(p) / 8] |=  (1 << ((p) % 8)))
-#define BITMAP_CLEAR(p)  (bitmap[(p) / 8] &= ~(1 << ((p) % 8)))
-#define BITMAP_TEST(p)   (bitmap[(p) / 8] &   (1 << ((p) % 8)))
+/* Next highmem page to look at */
+static uint32_t high_next = 0;
 
-void pmm_init(void) {
+/* Free pages, and pages handed out (held by someone), kept up to date by
+ * every allocation and free */
+static uint32_t free_pages = 0;
+static uint32_t used_pages = 0;
+
+/* Bitmap: 1 bit per page, in 32-bit words. 1 = used, 0 = free. */
+static uint32_t *bitmap;
+static uint32_t bitmap_words;
+
+#define BITMAP_SET(p)    (bitmap[(p) / 32] |=  (1u << ((p) % 32)))
+#define BITMAP_CLEAR(p)  (bitmap[(p) / 32] &= ~(1u << ((p) % 32)))
+#define BITMAP_TEST(p)   (bitmap[(p) / 32] &   (1u << ((p) % 32)))
+
+/* Owners of each allocated frame; the frame is freed when this drops to 0 */
+static uint8_t *refcount;
+
+/* Bytes of per-page metadata for every page: refcount[] */
+#define META_PER_PAGE    sizeof(uint8_t)
+
+/*
+ * Buddy allocator: free memory is kept as blocks of 2^order pages,
+ * aligned to their size, on one list per order. A block's buddy is the
+ * block it was split from (page index XOR size); freeing merges the two
+ * again whenever both are free, so alloc and free take O(PMM_MAX_ORDER).
+ * Lists are doubly linked through per-page arrays, so a free buddy can be
+ * unlinked in place without touching the page itself.
+ */
+#define NO_PAGE          0xFFFFFFFF
+#define NOT_HEAD         0xFF       /* free_order[]: not the head of a free block */
+
+static uint32_t free_head[PMM_MAX_ORDER + 1];
+static uint32_t *free_next;
+static uint32_t *free_prev;
+static uint8_t *free_order;
+
+/* Bytes of per-page metadata for lowmem pages: the arrays above */
+#define META_PER_LOW_PAGE (2 * sizeof(uint32_t) + sizeof(uint8_t))
+
+/* Frames requested from the reclaim hook per shortage */
+#define RECLAIM_BATCH    16
+
+static uint32_t (*reclaim_hook)(uint32_t pages) = 0;
+
+static void list_push(uint32_t page, uint32_t order) {
+    free_order[page] = order;
+    free_prev[page] = NO_PAGE;
+    free_next[page] = free_head[order];
+    if (free_head[order] != NO_PAGE)
+        free_prev[free_head[order]] = page;
+    free_head[order] = page;
+}
+
+static void list_remove(uint32_t page, uint32_t order) {
+    if (free_prev[page] != NO_PAGE)
+        free_next[free_prev[page]] = free_next[page];
+    else
+        free_head[order] = free_next[page];
+    if (free_next[page] != NO_PAGE)
+        free_prev[free_next[page]] = free_prev[page];
+    free_order[page] = NOT_HEAD;
+}
+
+/* Return a block to the free lists, merging it with free buddies */
+static void buddy_free(uint32_t page, uint32_t order) {
+    for (uint32_t p = page; p < page + (1u << order); p++)
+        BITMAP_CLEAR(p);
+    free_pages += 1u << order;
+
+    while (order < PMM_MAX_ORDER) {
+        uint32_t buddy = page ^ (1u << order);
+        if (buddy >= low_pages || free_order[buddy] != order)
+            break;
+        list_remove(buddy, order);
+        page &= ~(1u << order);
+        order++;
+    }
+    list_push(page, order);
+}
+
+/* Take a block of 2^order pages off the free lists, splitting a larger
+ * one if needed. Returns its first page index, or NO_PAGE. */
+static uint32_t buddy_alloc(uint32_t order) {
+    uint32_t o = order;
+    while (o <= PMM_MAX_ORDER && free_head[o] == NO_PAGE)
+        o++;
+    if (o > PMM_MAX_ORDER)
+        return NO_PAGE;
+
+    uint32_t page = free_head[o];
+    list_remove(page, o);
+
+    /* Keep the lower half, give the upper half back */
+    while (o > order) {
+        o--;
+        list_push(page + (1u << o), o);
+    }
+
+    for (uint32_t p = page; p < page + (1u << order); p++)
+        BITMAP_SET(p);
+    free_pages -= 1u << order;
+    return page;
+}
+
+/* Return pages [page, page + count) to the buddy lists as the largest
+ * aligned blocks that fit, dropping their references */
+static void release_range(uint32_t page, uint32_t count) {
+    for (uint32_t p = page; p < page + count; p++)
+        refcount[p] = 0;
+    used_pages -= count;
+
+    while (count > 0) {
+        uint32_t order = 0;
+        while (order < PMM_MAX_ORDER && !(page & (1u << order)) && (2u << order) <= count)
+            order++;
+        buddy_free(page, order);
+        page += 1u << order;
+        count -= 1u << order;
+    }
+}
+
+/* Whether an E820 entry describes RAM the PMM may hand out */
+static int e820_usable(const e820_entry_t *e) {
+    /* ACPI 3.0 attributes: bit 0 clear means ignore the entry */
+    return e->type == E820_USABLE && (e->attr & 1) && e->length != 0;
+}
+
+/* BIOS memory map pmm_init works from (the bootloader copy is reused later) */
+static const e820_entry_t *mem_map;
+static uint32_t mem_map_count;
+
+/* Whether a page is free RAM: inside a usable entry and no other entry */
+static int page_usable(uint32_t page) {
+    uint64_t start = (uint64_t)page * PAGE_SIZE;
+    uint64_t end = start + PAGE_SIZE;
+    int usable = 0;
+
+    for (uint32_t i = 0; i < mem_map_count; i++) {
+        const e820_entry_t *e = &mem_map[i];
+        if (e->base >= end || e->base + e->length <= start)
+            continue;
+        if (!e820_usable(e))
+            return 0;  /* Reserved wins over usable */
+        if (e->base <= start && e->base + e->length >= end)
+            usable = 1;
+    }
+    return usable;
+}
+
+/* First free page in [start, end), a bitmap word at a time: bsf on the
+ * inverted word finds its lowest clear bit. Returns NO_PAGE if none. */
+static uint32_t bitmap_find_free(uint32_t start, uint32_t end) {
+    if (start >= end)
+        return NO_PAGE;
+
+    uint32_t w = start / 32;
+    uint32_t free_bits = ~bitmap[w] & (0xFFFFFFFFu << (start % 32));
+    for (;;) {
+        if (free_bits) {
+            uint32_t p = w * 32 + __builtin_ctz(free_bits);
+            return p < end ? p : NO_PAGE;
+        }
+        if (++w >= (end + 31) / 32)
+            return NO_PAGE;
+        free_bits = ~bitmap[w];
+    }
+}
+
+/* Highmem page from the bitmap, searching on from the last one handed
+ * out and wrapping around once. Returns its index, or NO_PAGE. */
+static uint32_t high_alloc(void) {
+    if (free_pages == 0)
+        return NO_PAGE;
+
+    uint32_t p = bitmap_find_free(high_next, total_pages);
+    if (p == NO_PAGE)
+        p = bitmap_find_free(low_pages, high_next);
+    if (p == NO_PAGE)
+        return NO_PAGE;
+
+    BITMAP_SET(p);
+    free_pages--;
+    high_next = p + 1;
+    return p;
+}
+
+/* Where the per-page arrays go: the first usable stretch of lowmem above
+ * the boot kernel stack with room for them. Returns its physical address
+ * or 0. */
+static uint32_t place_metadata(uint32_t bytes) {
+    for (uint32_t i = 0; i < mem_map_count; i++) {
+        const e820_entry_t *e = &mem_map[i];
+        if (!e820_usable(e))
+            continue;
+        uint64_t start = e->base < KERNEL_STACK_TOP ? KERNEL_STACK_TOP : e->base;
+        start = (start + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+        uint64_t end = e->base + e->length;
+        if (start + bytes > end || start + bytes > (uint64_t)low_pages * PAGE_SIZE)
+            continue;
+
+        /* Every page of it must be usable, not just this entry */
+        uint32_t first = (uint32_t)(start / PAGE_SIZE);
+        uint32_t p = first;
+        while (p < first + (bytes + PAGE_SIZE - 1) / PAGE_SIZE && page_usable(p))
+            p++;
+        if (p == first + (bytes + PAGE_SIZE - 1) / PAGE_SIZE)
+            return (uint32_t)start;
+    }
+    return 0;
+}
+
+void pmm_init(const e820_map_t *map) {
     extern uint32_t _kernel_end;
 
+    /* No (sane) map from the BIOS: assume 16MB of RAM, as before E820 */
+    static const e820_entry_t fallback = { 0, 16 * 1024 * 1024, E820_USABLE, 1 };
+    if (map && map->count > 0 && map->count <= E820_MAX_ENTRIES) {
+        mem_map = map->entries;
+        mem_map_count = map->count;
+    } else {
+        mem_map = &fallback;
+        mem_map_count = 1;
+    }
+
+    /* Manage RAM up to the highest usable byte page tables can reach */
+    uint64_t top = 0;
+    for (uint32_t i = 0; i < mem_map_count; i++) {
+        const e820_entry_t *e = &mem_map[i];
+        if (e820_usable(e) && e->base + e->length > top)
+            top = e->base + e->length;
+    }
+    if (top > PHYS_LIMIT)
+        top = PHYS_LIMIT;
+    total_pages = (uint32_t)(top / PAGE_SIZE);
+    low_pages = total_pages < LOWMEM_LIMIT / PAGE_SIZE ? total_pages : LOWMEM_LIMIT / PAGE_SIZE;
+    high_next = low_pages;
+
+    /* Carve the per-page arrays out of lowmem itself */
+    bitmap_words = (total_pages + 31) / 32;
+    uint32_t meta_bytes = low_pages * META_PER_LOW_PAGE +
+                          total_pages * META_PER_PAGE + bitmap_words * 4;
+    uint32_t meta = place_metadata(meta_bytes);
+    if (meta == 0) {
+        /* Cannot happen with the 2MB+ the kernel needs anyway */
+        __asm__ volatile("cli; hlt");
+    }
+    free_next = (uint32_t *)PHYS_TO_VIRT(meta);
+    free_prev = free_next + low_pages;
+    bitmap = free_prev + low_pages;
+    free_order = (uint8_t *)(bitmap + bitmap_words);
+    refcount = free_order + low_pages;
+    uint32_t meta_first = meta / PAGE_SIZE;
+    uint32_t meta_end = (meta + meta_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+
     /* Mark all pages as used */
-    for (uint32_t i = 0; i < sizeof(bitmap); i++) {
-        bitmap[i] = 0xFF;
+    for (uint32_t i = 0; i < bitmap_words; i++) {
+        bitmap[i] = 0xFFFFFFFF;
+    }
+    free_pages = 0;
+    used_pages = 0;
+    for (uint32_t o = 0; o <= PMM_MAX_ORDER; o++) {
+        free_head[o] = NO_PAGE;
+    }
+    for (uint32_t p = 0; p < low_pages; p++) {
+        free_order[p] = NOT_HEAD;
+    }
+    for (uint32_t p = 0; p < total_pages; p++) {
+        refcount[p] = 0;
     }
 
     /* Calculate kernel end page (rounded up) */
-    uint32_t kend = (uint32_t)&_kernel_end;
+    uint32_t kend = VIRT_TO_PHYS(&_kernel_end);
     uint32_t kend_page = (kend + PAGE_SIZE - 1) / PAGE_SIZE;
 
-    /* Free pages between kernel end and kernel stack (0x1F0000),
-     * but skip the BIOS/VGA/ROM area (0xA0000-0xFFFFF) */
-    for (uint32_t p = kend_page; p < 0x1F0000 / PAGE_SIZE; p++) {
+    /* Free every usable page above the kernel, but skip the BIOS/VGA/ROM
+     * area (0xA0000-0xFFFFF), the boot kernel stack and the arrays above.
+     * Neighbours merge into blocks as they go in. */
+    for (uint32_t p = kend_page; p < total_pages; p++) {
         if (p >= 0xA0000 / PAGE_SIZE && p <= 0xFFFFF / PAGE_SIZE)
             continue;
-        BITMAP_CLEAR(p);
+        if (p >= (KERNEL_STACK_TOP - KERNEL_STACK_SIZE) / PAGE_SIZE &&
+            p < KERNEL_STACK_TOP / PAGE_SIZE)
+            continue;
+        if (p >= meta_first && p < meta_end)
+            continue;
+        if (!BITMAP_TEST(p) || !page_usable(p))
+            continue;
+        if (p < low_pages) {
+            buddy_free(p, 0);
+        } else {
+            BITMAP_CLEAR(p);
+            free_pages++;
+        }
     }
+}
 
-    /* Free pages above the userspace area (0x300000+) */
-    for (uint32_t p = 0x300000 / PAGE_SIZE; p < TOTAL_PAGES; p++) {
-        BITMAP_CLEAR(p);
-    }
+uint32_t pmm_alloc_order(uint32_t order) {
+    if (order > PMM_MAX_ORDER)
+        return 0;
+
+    uint32_t page = buddy_alloc(order);
+
+    /* Out of frames: let the page cache give some back and retry once */
+    if (page == NO_PAGE && reclaim_hook && reclaim_hook(RECLAIM_BATCH << order) > 0)
+        page = buddy_alloc(order);
+    if (page == NO_PAGE)
+        return 0;
+
+    for (uint32_t p = page; p < page + (1u << order); p++)
+        refcount[p] = 1;
+    used_pages += 1u << order;
+    return PHYS_TO_VIRT(page * PAGE_SIZE);
 }
 
 uint32_t pmm_alloc(void) {
-    for (uint32_t i = 0; i < sizeof(bitmap); i++) {
-        if (bitmap[i] == 0xFF)
-            continue;
-        for (int bit = 0; bit < 8; bit++) {
-            if (!(bitmap[i] & (1 << bit))) {
-                bitmap[i] |= (1 << bit);
-                return (i * 8 + bit) * PAGE_SIZE;
-            }
-        }
+    return pmm_alloc_order(0);
+}
+
+/* Only pages allocated and held once may be freed as a run: anything else
+ * (a double free, a run reaching past the allocation, a shared page)
+ * would put pages on the free lists twice */
+static int held_once(uint32_t page, uint32_t count) {
+    for (uint32_t p = page; p < page + count; p++) {
+        if (refcount[p] != 1)
+            return 0;
     }
-    return 0;  /* Out of memory */
+    return 1;
+}
+
+void pmm_free_order(uint32_t addr, uint32_t order) {
+    uint32_t page = VIRT_TO_PHYS(addr) / PAGE_SIZE;
+    if (order > PMM_MAX_ORDER || (page & ((1u << order) - 1)) ||
+        page == 0 || page + (1u << order) > low_pages)
+        return;
+    if (!held_once(page, 1u << order))
+        return;
+
+    release_range(page, 1u << order);
+}
+
+uint32_t pmm_alloc_pages(uint32_t count) {
+    if (count == 0)
+        return 0;
+
+    /* Smallest block that holds them; the tail goes straight back */
+    uint32_t order = 0;
+    while ((1u << order) < count)
+        order++;
+    uint32_t addr = pmm_alloc_order(order);
+    if (addr == 0)
+        return 0;
+
+    uint32_t page = VIRT_TO_PHYS(addr) / PAGE_SIZE;
+    release_range(page + count, (1u << order) - count);
+    return addr;
+}
+
+void pmm_free_pages(uint32_t addr, uint32_t count) {
+    uint32_t page = VIRT_TO_PHYS(addr) / PAGE_SIZE;
+    if (page == 0 || count == 0 || count > low_pages || page + count > low_pages)
+        return;
+    if (!held_once(page, count))
+        return;
+
+    release_range(page, count);
 }
 
 void pmm_free(uint32_t addr) {
-    uint32_t page = addr / PAGE_SIZE;
-    if (page > 0 && page < TOTAL_PAGES) {
-        BITMAP_CLEAR(page);
+    pmm_free_pfn(VIRT_TO_PHYS(addr) / PAGE_SIZE);
+}
+
+int pmm_ref(uint32_t addr) {
+    return pmm_ref_pfn(VIRT_TO_PHYS(addr) / PAGE_SIZE);
+}
+
+uint32_t pmm_ref_count(uint32_t addr) {
+    return pmm_ref_count_pfn(VIRT_TO_PHYS(addr) / PAGE_SIZE);
+}
+
+uint32_t pmm_alloc_user(void) {
+    uint32_t page = high_alloc();
+    if (page != NO_PAGE) {
+        refcount[page] = 1;
+        used_pages++;
+        return page;
     }
+
+    uint32_t frame = pmm_alloc();
+    return frame ? VIRT_TO_PHYS(frame) / PAGE_SIZE : 0;
 }
 
-uint32_t pmm_get_free_count(void) {
-    uint32_t count = 0;
-    for (uint32_t i = 0; i < sizeof(bitmap); i++) {
-        uint8_t b = bitmap[i];
-        /* Count zero bits (free pages) */
-        for (int bit = 0; bit < 8; bit++) {
-            if (!(b & (1 << bit)))
-                count++;
+void pmm_free_pfn(uint32_t pfn) {
+    if (pfn > 0 && pfn < total_pages) {
+        if (refcount[pfn] > 1) {
+            refcount[pfn]--;
+            return;
+        }
+        if (refcount[pfn] == 0)
+            return;  /* Not allocated */
+        refcount[pfn] = 0;
+        used_pages--;
+        if (pfn < low_pages) {
+            buddy_free(pfn, 0);
+        } else {
+            BITMAP_CLEAR(pfn);
+            free_pages++;
         }
     }
-    return count;
+}
+
+int pmm_ref_pfn(uint32_t pfn) {
+    if (pfn == 0 || pfn >= total_pages || refcount[pfn] == 0 || refcount[pfn] == 0xFF)
+        return -1;
+    refcount[pfn]++;
+    return 0;
+}
+
+uint32_t pmm_ref_count_pfn(uint32_t pfn) {
+    return pfn < total_pages ? refcount[pfn] : 0;
+}
+
+uint32_t pmm_get_free_count(void) {
+    return free_pages;
+}
+
+uint32_t pmm_get_used_count(void) {
+    return used_pages;
 }
 
 uint32_t pmm_get_total_count(void) {
-    return TOTAL_PAGES;
+    return total_pages;
+}
+
+uint32_t pmm_get_low_count(void) {
+    return low_pages;
+}
+
+void pmm_set_reclaim_hook(uint32_t (*hook)(uint32_t pages)) {
+    reclaim_hook = hook;
 }
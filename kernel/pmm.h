@@ -4,22 +4,115 @@
 #include <stdint.h>
 
 #define PAGE_SIZE       4096
-#define TOTAL_MEMORY    (16 * 1024 * 1024)          /* 16MB assumed */
-#define TOTAL_PAGES     (TOTAL_MEMORY / PAGE_SIZE)  /* 4096 pages */
 
-/* Initialize the physical memory manager */
-void pmm_init(void);
+/*
+ * The kernel runs in the top 1GB: the first LOWMEM_LIMIT bytes of
+ * physical memory (lowmem) are mapped at KERNEL_BASE, in every address
+ * space. Lowmem frames are handed out and taken back by their address in
+ * that direct map; only page tables and CR3 hold physical addresses.
+ *
+ * RAM above it (highmem: up to 4GB, or 64GB with PAE) has no kernel
+ * address. It is handed out by page frame number for user memory only,
+ * and paging.c reaches it through the KMAP_BASE window when needed.
+ */
+#define KERNEL_BASE     0xC0000000
+#define KMAP_BASE       0xFFC00000      /* Top 4MB: temporary mappings */
+#define LOWMEM_LIMIT    (KMAP_BASE - KERNEL_BASE)
+#define PHYS_TO_VIRT(addr) ((uint32_t)(addr) + KERNEL_BASE)
+#define VIRT_TO_PHYS(addr) ((uint32_t)(addr) - KERNEL_BASE)
 
-/* Allocate a single physical page, returns physical address or 0 on failure */
+/* Physical address space page tables can reach */
+#ifdef CONFIG_PAE
+#define PHYS_LIMIT      (1ULL << 36)
+#else
+#define PHYS_LIMIT      (1ULL << 32)
+#endif
+
+/* Boot kernel stack (physical, grows down from the top); kept out of the PMM */
+#define KERNEL_STACK_TOP  0x1F0000
+#define KERNEL_STACK_SIZE 0x4000
+
+/* Largest block pmm_alloc_order hands out: 2^10 pages = 4MB */
+#define PMM_MAX_ORDER   10
+
+/*
+ * BIOS memory map (INT 15h, E820), collected by the bootloader at
+ * E820_MAP_ADDR (physical) and passed to kernel_main. Must match
+ * bootloader/boot.asm.
+ */
+#define E820_MAP_ADDR     0x80000
+#define E820_MAX_ENTRIES  64
+#define E820_USABLE       1
+
+typedef struct {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;              /* E820_USABLE, or reserved/ACPI/bad */
+    uint32_t attr;              /* ACPI 3.0 attributes; bit 0 clear = ignore */
+} __attribute__((packed)) e820_entry_t;
+
+typedef struct {
+    uint32_t count;
+    e820_entry_t entries[E820_MAX_ENTRIES];
+} __attribute__((packed)) e820_map_t;
+
+/* Initialize the physical memory manager from the BIOS memory map (NULL
+ * or empty = assume 16MB). Its bookkeeping is sized to the RAM found. */
+void pmm_init(const e820_map_t *map);
+
+/* Allocate a single physical page, returns its direct-map address or 0 */
 uint32_t pmm_alloc(void);
 
-/* Free a previously allocated physical page */
+/* Allocate 2^order physically contiguous pages, aligned to their size.
+ * Returns the direct-map address of the first one, or 0. */
+uint32_t pmm_alloc_order(uint32_t order);
+
+/* Free a whole block from pmm_alloc_order. Ignored unless every page in
+ * it is allocated with a single reference. */
+void pmm_free_order(uint32_t addr, uint32_t order);
+
+/* Allocate count physically contiguous pages (up to 2^PMM_MAX_ORDER),
+ * without rounding up to a power of two. Returns the direct-map address
+ * of the first one, or 0. */
+uint32_t pmm_alloc_pages(uint32_t count);
+
+/* Free pages from pmm_alloc_pages, or any run of them. Ignored unless
+ * every page in the run is allocated with a single reference. */
+void pmm_free_pages(uint32_t addr, uint32_t count);
+
+/* Drop one reference to a page; it is freed when the last one goes */
 void pmm_free(uint32_t addr);
 
-/* Get count of free pages */
+/* Allocate a frame for user memory: highmem if any is free, else lowmem.
+ * Returns its page frame number (physical address / PAGE_SIZE), or 0. */
+uint32_t pmm_alloc_user(void);
+
+/* pmm_free, pmm_ref and pmm_ref_count by page frame number (any frame) */
+void pmm_free_pfn(uint32_t pfn);
+int pmm_ref_pfn(uint32_t pfn);
+uint32_t pmm_ref_count_pfn(uint32_t pfn);
+
+/* Take another reference to an allocated page (shared mappings).
+ * Returns 0, or -1 if the page is not allocated or the count is full. */
+int pmm_ref(uint32_t addr);
+
+/* References held on a page (0 = free or never allocated) */
+uint32_t pmm_ref_count(uint32_t addr);
+
+/* Get count of free pages (a running counter, O(1)) */
 uint32_t pmm_get_free_count(void);
 
+/* Pages currently allocated; reserved and missing RAM count in neither */
+uint32_t pmm_get_used_count(void);
+
 /* Get total number of pages */
 uint32_t pmm_get_total_count(void);
 
+/* Pages of lowmem (direct-mapped) the PMM manages */
+uint32_t pmm_get_low_count(void);
+
+/* Register a callback that gives back up to `pages` frames when pmm_alloc
+ * runs dry (the page cache); returns how many it freed */
+void pmm_set_reclaim_hook(uint32_t (*hook)(uint32_t pages));
+
 #endif /* PMM_H */
@@ -1,10 +1,89 @@
 #include "process.h"
 #include "pmm.h"
+#include "paging.h"
+#include "gdt.h"
+#include "idt.h"
+#include "heap.h"
+#include "file.h"
+#include "aio.h"
+
+/* ISR exit path in isr.asm: pops an isr_regs frame and irets */
+extern void isr_return(void);
 
 static process_t proc_table[MAX_PROCESSES];
 static process_t *current_proc = 0;
 static uint32_t next_pid = 0;
 
+static void set_name(process_t *p, const char *name) {
+    int i;
+    for (i = 0; name[i] && i < 15; i++)
+        p->name[i] = name[i];
+    p->name[i] = '\0';
+}
+
+static void reap(process_t *p) {
+    if (p->kernel_stack)
+        pmm_free(p->kernel_stack);
+    if (p->args)
+        kfree(p->args);
+    p->kernel_stack = 0;
+    p->args = 0;
+    p->state = PROC_UNUSED;
+}
+
+/* An exited process stays until its parent collects the exit code; once
+ * the parent is gone too, nobody can */
+static int orphaned(process_t *p) {
+    process_t *parent = process_get(p->parent);
+    return !parent || parent->state == PROC_TERMINATED;
+}
+
+/* Find a free slot, reaping exited processes nobody will wait for */
+static process_t *alloc_slot(void) {
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        process_t *p = &proc_table[i];
+        if (p->state == PROC_TERMINATED && p != current_proc && orphaned(p))
+            reap(p);
+        if (p->state == PROC_UNUSED) {
+            p->kernel_stack = 0;
+            p->esp0 = 0;
+            p->frame = 0;
+            p->exec_ctx = 0;
+            p->image = 0;
+            p->image_file = 0;
+            p->args = 0;
+            for (int fd = 0; fd < MAX_OPEN_FILES; fd++)
+                p->files[fd] = 0;
+            p->aio = 0;
+            p->heap_start = 0;
+            p->brk = 0;
+            p->exit_code = 0;
+            p->wait_for = 0;
+            return p;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Build a kernel stack that enters user mode: `regs` on top, then a
+ * context_switch frame whose ret lands in the ISR exit path, which
+ * restores regs and irets.
+ */
+static void setup_user_stack(process_t *p, uint32_t stack_page, const struct isr_regs *regs) {
+    struct isr_regs *top = (struct isr_regs *)(stack_page + PAGE_SIZE) - 1;
+    *top = *regs;
+
+    uint32_t *sp = (uint32_t *)top;
+    *(--sp) = (uint32_t)isr_return;
+    for (int i = 0; i < 8; i++)
+        *(--sp) = 0;  /* popa */
+
+    p->kernel_stack = stack_page;
+    p->esp0 = stack_page + PAGE_SIZE;
+    p->esp = (uint32_t)sp;
+}
+
 void process_init(void) {
     /* Zero the process table */
     for (int i = 0; i < MAX_PROCESSES; i++) {
@@ -15,30 +94,28 @@ void process_init(void) {
     /* Create PID 0: the kernel process */
     proc_table[0].pid = next_pid++;
     proc_table[0].state = PROC_RUNNING;
-    proc_table[0].esp = 0x1F0000;
-    proc_table[0].kernel_stack = 0x1F0000;
-    proc_table[0].page_directory = 0;
+    proc_table[0].esp = PHYS_TO_VIRT(KERNEL_STACK_TOP);
+    proc_table[0].kernel_stack = PHYS_TO_VIRT(KERNEL_STACK_TOP);
+    proc_table[0].page_directory = (uint32_t)kernel_page_directory;
+    proc_table[0].parent = 0;
+    proc_table[0].esp0 = 0;
+    proc_table[0].frame = 0;
+    proc_table[0].exec_ctx = 0;
+    proc_table[0].image = 0;
+    proc_table[0].image_file = 0;
+    proc_table[0].args = 0;
+    proc_table[0].aio = 0;
+    proc_table[0].wait_for = 0;
 
-    /* Set name */
-    const char *name = "kernel";
-    int i;
-    for (i = 0; name[i] && i < 15; i++)
-        proc_table[0].name[i] = name[i];
-    proc_table[0].name[i] = '\0';
+    set_name(&proc_table[0], "kernel");
 
     current_proc = &proc_table[0];
 }
 
 int process_create(const char *name, uint32_t entry) {
     /* Find a free slot */
-    int slot = -1;
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (proc_table[i].state == PROC_UNUSED) {
-            slot = i;
-            break;
-        }
-    }
-    if (slot < 0)
+    process_t *p = alloc_slot();
+    if (!p)
         return -1;
 
     /* Allocate kernel stack (1 page = 4KB) */
@@ -46,12 +123,12 @@ int process_create(const char *name, uint32_t entry) {
     if (stack_page == 0)
         return -1;
 
-    process_t *p = &proc_table[slot];
     p->pid = next_pid++;
     p->state = PROC_READY;
     p->kernel_stack = stack_page;
     p->eip = entry;
-    p->page_directory = 0;  /* Shared with kernel for now */
+    p->page_directory = (uint32_t)kernel_page_directory;  /* Kernel thread */
+    p->parent = current_proc ? current_proc->pid : 0;
 
     /*
      * Build initial stack frame for context_switch:
@@ -80,15 +157,197 @@ int process_create(const char *name, uint32_t entry) {
     *(--sp) = 0;        /* EAX */
     p->esp = (uint32_t)sp;
 
-    /* Set name */
-    int i;
-    for (i = 0; name[i] && i < 15; i++)
-        p->name[i] = name[i];
-    p->name[i] = '\0';
+    set_name(p, name);
 
     return (int)p->pid;
 }
 
+process_t *process_start_exec(const char *name, uint32_t *space) {
+    process_t *p = alloc_slot();
+    if (!p || !current_proc)
+        return 0;
+
+    /* Runs on the parent's kernel stack until it exits */
+    p->pid = next_pid++;
+    p->state = PROC_RUNNING;
+    p->esp = 0;
+    p->eip = 0;
+    p->page_directory = (uint32_t)space;
+    p->parent = current_proc->pid;
+    set_name(p, name);
+
+    current_proc->state = PROC_BLOCKED;
+    current_proc = p;
+    paging_switch(space);
+    return p;
+}
+
+void process_end_exec(process_t *child) {
+    /* Whatever the program left open goes with it */
+    file_close_all(child);
+    aio_release(child->aio);
+    child->aio = 0;
+
+    process_t *parent = process_get(child->parent);
+    if (parent) {
+        parent->state = PROC_RUNNING;
+        current_proc = parent;
+        paging_switch((uint32_t *)parent->page_directory);
+        if (parent->esp0)
+            tss_set_kernel_stack(parent->esp0);
+    } else {
+        current_proc = &proc_table[0];
+        paging_switch(kernel_page_directory);
+    }
+
+    paging_destroy_space((uint32_t *)child->page_directory);
+    child->page_directory = 0;
+    child->exec_ctx = 0;
+    child->state = PROC_UNUSED;
+}
+
+process_t *process_fork(uint32_t *space) {
+    process_t *parent = current_proc;
+    if (!parent || !parent->frame)
+        return 0;
+
+    process_t *p = alloc_slot();
+    if (!p)
+        return 0;
+    uint32_t stack_page = pmm_alloc();
+    if (stack_page == 0)
+        return 0;
+
+    p->pid = next_pid++;
+    p->state = PROC_BLOCKED;
+    p->eip = parent->frame->eip;
+    p->page_directory = (uint32_t)space;
+    p->parent = parent->pid;
+    p->heap_start = parent->heap_start;
+    p->brk = parent->brk;
+    set_name(p, parent->name);
+
+    /* Resume from the parent's syscall, with 0 as the child's fork result */
+    struct isr_regs regs = *parent->frame;
+    regs.eax = 0;
+    setup_user_stack(p, stack_page, &regs);
+
+    return p;
+}
+
+process_t *process_spawn(const char *name, uint32_t *space, uint32_t entry, uint32_t stack) {
+    process_t *p = alloc_slot();
+    if (!p || !current_proc)
+        return 0;
+    uint32_t stack_page = pmm_alloc();
+    if (stack_page == 0)
+        return 0;
+
+    p->pid = next_pid++;
+    p->state = PROC_BLOCKED;
+    p->eip = entry;
+    p->page_directory = (uint32_t)space;
+    p->parent = current_proc->pid;
+    set_name(p, name);
+
+    /* First return to user mode lands on the entry point */
+    struct isr_regs regs;
+    uint32_t *r = (uint32_t *)&regs;
+    for (uint32_t i = 0; i < sizeof(regs) / 4; i++)
+        r[i] = 0;
+    regs.ds = 0x23;        /* USER_DS | RPL 3 */
+    regs.eip = entry;
+    regs.cs = 0x1B;        /* USER_CS | RPL 3 */
+    regs.eflags = 0x202;   /* IF */
+    regs.useresp = stack;
+    regs.ss = 0x23;
+    setup_user_stack(p, stack_page, &regs);
+
+    return p;
+}
+
+void process_wake(process_t *p) {
+    if (p->state == PROC_BLOCKED)
+        p->state = PROC_READY;
+}
+
+void process_yield(void) {
+    __asm__ volatile("cli");
+    schedule();
+    __asm__ volatile("sti");
+}
+
+void process_exit(int code) {
+    process_t *p = current_proc;
+
+    file_close_all(p);
+    aio_release(p->aio);
+    p->aio = 0;
+
+    __asm__ volatile("cli");
+    paging_switch(kernel_page_directory);
+    paging_destroy_space((uint32_t *)p->page_directory);
+    p->page_directory = (uint32_t)kernel_page_directory;
+    p->exit_code = code;
+    p->state = PROC_TERMINATED;
+
+    /* Hand the exit code to a parent blocked in process_wait */
+    process_t *parent = process_get(p->parent);
+    if (parent && parent->wait_for != 0 &&
+        (parent->wait_for == -1 || (uint32_t)parent->wait_for == p->pid))
+        process_wake(parent);
+
+    /* The slot and kernel stack are reaped once the parent collects the code */
+    for (;;) {
+        schedule();
+        __asm__ volatile("sti; hlt; cli");
+    }
+}
+
+int process_wait(int pid, int *status, int nohang) {
+    process_t *cur = current_proc;
+
+    for (;;) {
+        int children = 0;
+
+        __asm__ volatile("cli");
+        for (int i = 0; i < MAX_PROCESSES; i++) {
+            process_t *p = &proc_table[i];
+            if (p->state == PROC_UNUSED || p == cur || p->parent != cur->pid)
+                continue;
+            if (pid != -1 && p->pid != (uint32_t)pid)
+                continue;
+
+            children++;
+            if (p->state == PROC_TERMINATED) {
+                int found = (int)p->pid;
+                int code = p->exit_code;
+                reap(p);
+                __asm__ volatile("sti");
+                if (status)
+                    *status = code;  /* May fault in a user page */
+                return found;
+            }
+        }
+
+        if (children == 0 || nohang) {
+            __asm__ volatile("sti");
+            return children == 0 ? -1 : 0;
+        }
+
+        /* Sleep until a matching child exits */
+        cur->wait_for = pid;
+        cur->state = PROC_BLOCKED;
+        schedule();
+        if (cur->state == PROC_BLOCKED)
+            __asm__ volatile("sti; hlt");  /* Nothing else ready yet */
+        __asm__ volatile("cli");
+        cur->wait_for = 0;
+        cur->state = PROC_RUNNING;
+        __asm__ volatile("sti");
+    }
+}
+
 process_t *process_get_current(void) {
     return current_proc;
 }
@@ -127,6 +386,11 @@ void schedule(void) {
     new->state = PROC_RUNNING;
     current_proc = new;
 
+    if (new->page_directory != old->page_directory)
+        paging_switch((uint32_t *)new->page_directory);
+    if (new->esp0)
+        tss_set_kernel_stack(new->esp0);
+
     context_switch(&old->esp, new->esp);
 }
 
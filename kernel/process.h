@@ -2,8 +2,10 @@
 #define PROCESS_H
 
 #include <stdint.h>
+#include "args.h"
 
 #define MAX_PROCESSES 16
+#define MAX_OPEN_FILES 16       /* Descriptors per process */
 
 typedef enum {
     PROC_UNUSED = 0,
@@ -13,6 +15,11 @@ typedef enum {
     PROC_TERMINATED
 } proc_state_t;
 
+struct isr_regs;
+struct exec_image;
+struct vfs_file;
+struct aio_ctx;
+
 typedef struct {
     uint32_t pid;
     char name[16];
@@ -22,9 +29,25 @@ typedef struct {
     uint32_t esp;
     uint32_t eip;
     uint32_t page_directory;  /* CR3 for per-process paging */
+    uint32_t parent;          /* PID of the process that exec'd or forked this one */
 
-    /* Kernel stack allocated via pmm_alloc */
+    /* Kernel stack allocated via pmm_alloc (0 = runs on the parent's) */
     uint32_t kernel_stack;
+    uint32_t esp0;            /* TSS.esp0 while in user mode (0 = kernel thread) */
+
+    /* User program state */
+    struct isr_regs *frame;          /* Registers of the syscall in progress */
+    void *exec_ctx;                  /* Exec return point in the parent, NULL if forked */
+    struct exec_image *image;        /* Image backing demand-paged memory */
+    struct vfs_file *image_file;
+    program_args_t *args;            /* Own arguments (spawned), NULL = global ones */
+    struct vfs_file *files[MAX_OPEN_FILES];  /* Open descriptors (file.c) */
+    struct aio_ctx *aio;             /* Registered async I/O ring, NULL if none */
+    uint32_t heap_start;             /* First page after the image */
+    uint32_t brk;                    /* Current program break */
+
+    int exit_code;                   /* Kept until the parent collects it */
+    int wait_for;                    /* Child pid blocked on in process_wait, -1 = any */
 } process_t;
 
 /* Initialize process subsystem (creates PID 0 = kernel) */
@@ -33,6 +56,41 @@ void process_init(void);
 /* Create a new process, returns pid or -1 on failure */
 int process_create(const char *name, uint32_t entry);
 
+/* Enter a program: the caller blocks and a child owning the address
+ * space becomes current (CR3 switched). Returns the child or NULL. */
+process_t *process_start_exec(const char *name, uint32_t *space);
+
+/* Leave a program: the parent and its address space become current
+ * again, and the child's address space is freed */
+void process_end_exec(process_t *child);
+
+/* Clone the current user process with a copy-on-write address space.
+ * The child resumes from the current syscall with EAX = 0. Returns the
+ * child, blocked until process_wake, or NULL. */
+process_t *process_fork(uint32_t *space);
+
+/* Create a user process that starts at entry in space with the given
+ * user stack pointer, a child of the current one. Returns the child,
+ * blocked until process_wake, or NULL. */
+process_t *process_spawn(const char *name, uint32_t *space, uint32_t entry, uint32_t stack);
+
+/* Make a blocked process runnable */
+void process_wake(process_t *p);
+
+/* Give up the CPU from inside a syscall while waiting (the timer only
+ * switches processes that it interrupts in user mode) */
+void process_yield(void);
+
+/* End the current process for good (forked or spawned): its address
+ * space is freed, the exit code kept for process_wait and the CPU goes
+ * to another process. Never returns. */
+void process_exit(int code) __attribute__((noreturn));
+
+/* Collect an exited child (pid, or -1 for any). Returns its pid with the
+ * exit code in *status; 0 if nohang and none has exited yet; -1 if
+ * there is no such child. Blocks otherwise. */
+int process_wait(int pid, int *status, int nohang);
+
 /* Get current running process */
 process_t *process_get_current(void);
 
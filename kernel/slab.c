@@ -0,0 +1,119 @@
+#include "slab.h"
+#include "pmm.h"
+
+#define CACHE_LINE      64
+
+/* Slab header, at the start of its page */
+struct slab {
+    slab_t *prev;               /* On the cache's partial list */
+    slab_t *next;
+    void *free;                 /* First free object */
+    uint32_t in_use;
+};
+
+/* First object sits a cache line in, clear of the header */
+#define SLAB_FIRST      CACHE_LINE
+
+#define SLAB_OF(obj)    ((slab_t *)((uint32_t)(obj) & ~(uint32_t)(PAGE_SIZE - 1)))
+
+static void partial_push(slab_cache_t *cache, slab_t *slab) {
+    slab->prev = 0;
+    slab->next = cache->partial;
+    if (cache->partial)
+        cache->partial->prev = slab;
+    cache->partial = slab;
+}
+
+static void partial_remove(slab_cache_t *cache, slab_t *slab) {
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        cache->partial = slab->next;
+    if (slab->next)
+        slab->next->prev = slab->prev;
+}
+
+/* Work out the object layout from the requested size */
+static void cache_setup(slab_cache_t *cache) {
+    uint32_t stride = cache->size < sizeof(void *) ? sizeof(void *) : cache->size;
+    if (stride <= 16)
+        stride = 16;
+    else if (stride <= 32)
+        stride = 32;
+    else
+        stride = (stride + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+
+    cache->stride = stride;
+    cache->per_slab = (PAGE_SIZE - SLAB_FIRST) / stride;
+}
+
+/* Add a fresh slab to the partial list; 0 or -1 if out of memory */
+static int cache_grow(slab_cache_t *cache) {
+    uint32_t page = pmm_alloc();
+    if (!page)
+        return -1;
+
+    slab_t *slab = (slab_t *)page;
+    slab->in_use = 0;
+    slab->free = 0;
+
+    /* Chain the objects so the lowest address is handed out first */
+    for (uint32_t i = cache->per_slab; i-- > 0; ) {
+        void **obj = (void **)(page + SLAB_FIRST + i * cache->stride);
+        *obj = slab->free;
+        slab->free = obj;
+    }
+
+    partial_push(cache, slab);
+    cache->slabs++;
+    return 0;
+}
+
+void *slab_alloc(slab_cache_t *cache) {
+    if (cache->per_slab == 0)
+        cache_setup(cache);
+    if (cache->size > PAGE_SIZE - SLAB_FIRST)
+        return 0;
+
+    /* pmm_alloc may reclaim page cache entries into this very cache, so
+     * the partial list is read only after growing */
+    if (!cache->partial && cache_grow(cache) != 0)
+        return 0;
+
+    slab_t *slab = cache->partial;
+    void **obj = (void **)slab->free;
+    slab->free = *obj;
+    if (slab->in_use++ == 0 && cache->empty == slab)
+        cache->empty = 0;
+    if (!slab->free)
+        partial_remove(cache, slab);
+    cache->in_use++;
+
+    if (cache->ctor)
+        cache->ctor(obj);
+    return obj;
+}
+
+void slab_free(slab_cache_t *cache, void *obj) {
+    if (!obj)
+        return;
+
+    slab_t *slab = SLAB_OF(obj);
+    if (!slab->free)
+        partial_push(cache, slab);  /* Was full */
+    *(void **)obj = slab->free;
+    slab->free = obj;
+    cache->in_use--;
+
+    if (--slab->in_use > 0)
+        return;
+
+    /* Keep one free slab to absorb alloc/free churn; give others back */
+    if (cache->empty && cache->empty != slab) {
+        partial_remove(cache, slab);
+        pmm_free((uint32_t)slab);
+        cache->slabs--;
+    } else {
+        cache->empty = slab;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+
+/*
+ * Slab caches for small fixed-size kernel objects (vnodes, open files,
+ * page cache entries). Each slab is one PMM page: a header, then objects
+ * of a single size whose free ones are chained through their first word.
+ * Allocation pops the first free object of a partially used slab and
+ * freeing pushes it back, both O(1) with no search or coalescing.
+ *
+ * Objects are rounded up to 16, 32 or a multiple of 64 bytes, so none
+ * straddles a cache line boundary it does not have to.
+ */
+
+typedef struct slab slab_t;
+
+typedef struct {
+    const char *name;
+    uint32_t size;              /* Object size as requested */
+    void (*ctor)(void *obj);    /* Prepares every object handed out, or NULL */
+    uint32_t stride;            /* Bytes per object, set up on first use */
+    uint32_t per_slab;
+    slab_t *partial;            /* Slabs with at least one free object */
+    slab_t *empty;              /* One wholly free slab kept back, or NULL */
+    uint32_t slabs;             /* Pages held */
+    uint32_t in_use;            /* Objects handed out */
+} slab_cache_t;
+
+/* Static initializer: `static slab_cache_t c = SLAB_CACHE("x", sizeof(x_t), 0);`
+ * Caches need no other setup and work as soon as the PMM is up. */
+#define SLAB_CACHE(name, size, ctor) { (name), (size), (ctor), 0, 0, 0, 0, 0, 0 }
+
+/* Allocate an object from a cache; NULL if out of memory */
+void *slab_alloc(slab_cache_t *cache);
+
+/* Return an object to the cache it came from */
+void slab_free(slab_cache_t *cache, void *obj);
+
+#endif /* SLAB_H */
@@ -1,7 +1,7 @@
 #include "syscall.h"
 #include "vga.h"
 #include "elf.h"
-#include "fat32.h"
+#include "vfs.h"
 #include "serial.h"
 #include "args.h"
 #include "keyboard.h"
@@ -9,6 +9,13 @@
 #include "pmm.h"
 #include "heap.h"
 #include "process.h"
+#include "pagecache.h"
+#include "file.h"
+#include "aio.h"
+#include "tmpfs.h"
+#include "execcache.h"
+#include "paging.h"
+#include "mman.h"
 
 /* Memory functions */
 static uint32_t strlen(const char *str) {
@@ -17,22 +24,19 @@ static uint32_t strlen(const char *str) {
     return len;
 }
 
-/* Currently open file (only one file at a time) */
-static fat32_file_t *current_file = NULL;
-
 /* Syscall handler */
-uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
-    (void)arg3;  /* Unused */
-
+uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_t arg3,
+                         uint32_t arg4) {
     switch (syscall_num) {
         case SYSCALL_PRINT: {
             /* arg1 = pointer to string */
             const char *str = (const char *)arg1;
-            if (str) {
-                vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
-                vga_puts(str);
-                serial_puts(SERIAL_COM1, str);
+            if (!paging_user_string(str)) {
+                return (uint32_t)-1;
             }
+            vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+            vga_puts(str);
+            serial_puts(SERIAL_COM1, str);
             return 0;
         }
 
@@ -43,84 +47,77 @@ uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uin
             vga_puthex(arg1);
             vga_puts("]\n");
             /* Return control to kernel */
-            elf_return_to_kernel();
+            elf_return_to_kernel((int)arg1);
             return 0;
         }
 
         case SYSCALL_FILE_OPEN: {
-            /* arg1 = pointer to filename */
-            const char *filename = (const char *)arg1;
-            if (!filename) {
+            /* arg1 = pointer to filename, arg2 = O_* flags; returns fd */
+            if (!paging_user_string((const char *)arg1)) {
                 return (uint32_t)-1;
             }
+            return (uint32_t)file_open((const char *)arg1, arg2);
+        }
 
-            /* Close any previously open file */
-            if (current_file) {
-                fat32_close(current_file);
-                current_file = NULL;
-            }
-
-            /* Convert filename to uppercase for FAT32 */
-            char uppercase_filename[256];
-            uint32_t i;
-            for (i = 0; filename[i] && i < sizeof(uppercase_filename) - 1; i++) {
-                char ch = filename[i];
-                if (ch >= 'a' && ch <= 'z') {
-                    uppercase_filename[i] = ch - 32;  /* Convert to uppercase */
-                } else {
-                    uppercase_filename[i] = ch;
-                }
-            }
-            uppercase_filename[i] = '\0';
-
-            /* Open the file */
-            current_file = fat32_open(uppercase_filename);
-            if (!current_file) {
+        case SYSCALL_FILE_READ: {
+            /* arg1 = fd, arg2 = buffer pointer, arg3 = size */
+            if (!paging_user_range(arg2, arg3)) {
                 return (uint32_t)-1;
             }
-
-            return 0;
+            return (uint32_t)file_read((int)arg1, (uint8_t *)arg2, arg3);
         }
 
-        case SYSCALL_FILE_READ: {
-            /* arg1 = buffer pointer, arg2 = size */
-            uint8_t *buffer = (uint8_t *)arg1;
-            uint32_t size = arg2;
-
-            if (!buffer || !current_file) {
+        case SYSCALL_FILE_WRITE: {
+            /* arg1 = fd, arg2 = buffer pointer, arg3 = size */
+            if (!paging_user_range(arg2, arg3)) {
                 return (uint32_t)-1;
             }
+            return (uint32_t)file_write((int)arg1, (const uint8_t *)arg2, arg3);
+        }
 
-            /* Read from file */
-            int bytes_read = fat32_read(current_file, buffer, size);
-            if (bytes_read < 0) {
+        case SYSCALL_UNLINK: {
+            /* arg1 = pointer to path */
+            if (!paging_user_string((const char *)arg1)) {
                 return (uint32_t)-1;
             }
-
-            return (uint32_t)bytes_read;
+            return (uint32_t)vfs_unlink((const char *)arg1);
         }
 
         case SYSCALL_FILE_CLOSE: {
-            if (!current_file) {
-                return (uint32_t)-1;
-            }
+            /* arg1 = fd */
+            return (uint32_t)file_close((int)arg1);
+        }
 
-            fat32_close(current_file);
-            current_file = NULL;
-            return 0;
+        case SYSCALL_FADVISE: {
+            /* arg1 = fd, arg2 = offset, arg3 = length (0 = to EOF), arg4 = FADV_* advice */
+            return (uint32_t)file_advise((int)arg1, arg2, arg3, (int)arg4);
+        }
+
+        case SYSCALL_AIO_SETUP: {
+            /* arg1 = ring pointer (0 = unregister) */
+            return (uint32_t)aio_setup((aio_ring_t *)arg1);
+        }
+
+        case SYSCALL_AIO_ENTER: {
+            /* arg1 = SQEs to submit, arg2 = completions to wait for */
+            return (uint32_t)aio_enter(arg1, arg2);
         }
 
         case SYSCALL_LIST_DIR: {
-            /* arg1 = buffer pointer, arg2 = max entries */
-            fat32_dirinfo_t *buffer = (fat32_dirinfo_t *)arg1;
+            /* arg1 = buffer pointer, arg2 = max entries, arg3 = path (0 = root) */
+            vfs_dirent_t *buffer = (vfs_dirent_t *)arg1;
             uint32_t max_entries = arg2;
 
-            if (!buffer || max_entries == 0) {
+            if (max_entries == 0 || max_entries > USER_STACK_TOP / sizeof(vfs_dirent_t) ||
+                !paging_user_range(arg1, max_entries * sizeof(vfs_dirent_t))) {
+                return (uint32_t)-1;
+            }
+            if (arg3 && !paging_user_string((const char *)arg3)) {
                 return (uint32_t)-1;
             }
 
             /* Get directory listing */
-            int count = fat32_list_dir(buffer, (int)max_entries);
+            int count = vfs_readdir((const char *)arg3, buffer, (int)max_entries);
             if (count < 0) {
                 return (uint32_t)-1;
             }
@@ -133,25 +130,27 @@ uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uin
             int arg_idx = (int)arg1;
             char *buffer = (char *)arg2;
             uint32_t buf_size = arg3;
+            process_t *cur = process_get_current();
+            program_args_t *args = (cur && cur->args) ? cur->args : &current_program_args;
 
             /* If arg_idx == -1, return argument count */
             if (arg_idx == -1) {
-                return (uint32_t)current_program_args.count;
+                return (uint32_t)args->count;
             }
 
-            if (!buffer || buf_size == 0) {
+            if (buf_size == 0 || !paging_user_range(arg2, buf_size)) {
                 return (uint32_t)-1;
             }
 
             /* Check if index is valid */
-            if (arg_idx < 0 || arg_idx >= current_program_args.count) {
+            if (arg_idx < 0 || arg_idx >= args->count) {
                 return (uint32_t)-1;
             }
 
             /* Copy argument to buffer */
             uint32_t i;
-            for (i = 0; i < buf_size - 1 && current_program_args.args[arg_idx][i]; i++) {
-                buffer[i] = current_program_args.args[arg_idx][i];
+            for (i = 0; i < buf_size - 1 && args->args[arg_idx][i]; i++) {
+                buffer[i] = args->args[arg_idx][i];
             }
             buffer[i] = '\0';
 
@@ -172,14 +171,20 @@ uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uin
                 if (c != 0) {
                     return (uint32_t)(unsigned char)c;
                 }
-                __asm__ volatile("hlt");
+
+                /* Idle: work off queued async I/O, then let other
+                 * processes run before halting */
+                if (!aio_poll()) {
+                    process_yield();
+                    __asm__ volatile("hlt");
+                }
             }
         }
 
         case SYSCALL_EXEC: {
             /* arg1 = command string pointer */
             const char *cmd = (const char *)arg1;
-            if (!cmd) {
+            if (!paging_user_string(cmd)) {
                 return (uint32_t)-1;
             }
 
@@ -187,74 +192,18 @@ uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uin
             char program_name[64];
             parse_command_line(cmd, program_name, &current_program_args);
 
-            /* Convert program name to uppercase for FAT32 */
-            char filename[12];
-            int i;
-            for (i = 0; program_name[i] && i < 11; i++) {
-                char ch = program_name[i];
-                if (ch >= 'a' && ch <= 'z') {
-                    filename[i] = ch - 32;
-                } else {
-                    filename[i] = ch;
-                }
-            }
-            filename[i] = '\0';
-
             /* Try to open the file */
-            fat32_file_t *file = fat32_open(filename);
+            vfs_file_t *file = elf_open(program_name);
             if (!file) {
                 return (uint32_t)-1; /* File not found */
             }
 
-            /* Binary buffer for loading */
-            static uint8_t exec_buffer[65536];
-
-            if (file->size > sizeof(exec_buffer)) {
-                fat32_close(file);
-                return (uint32_t)-2; /* File too large */
-            }
-
-            int bytes_read = fat32_read(file, exec_buffer, file->size);
-            fat32_close(file);
-
-            if (bytes_read <= 0) {
-                return (uint32_t)-3; /* Failed to read */
-            }
-
-            /* Check if it's an ELF file */
-            if (exec_buffer[0] != 0x7f ||
-                exec_buffer[1] != 'E' ||
-                exec_buffer[2] != 'L' ||
-                exec_buffer[3] != 'F') {
-                return (uint32_t)-4; /* Not an ELF binary */
-            }
-
-            /*
-             * Save the current program's memory region (0x200000 - 0x300000)
-             * so it can be restored after the new program exits.
-             * This is necessary because all programs load to 0x200000.
-             */
-            static uint8_t saved_program[1048576 + 4096]; /* 1MB program + 4KB user stack */
-            uint8_t *program_base = (uint8_t *)0x200000;
-            uint32_t save_size = sizeof(saved_program);
-
-            /* Save current program memory */
-            for (uint32_t j = 0; j < save_size; j++) {
-                saved_program[j] = program_base[j];
-            }
-
-            /* Execute the binary */
-            if (elf_load_and_exec(exec_buffer, bytes_read) != 0) {
-                /* Restore caller's memory before returning error */
-                for (uint32_t j = 0; j < save_size; j++) {
-                    program_base[j] = saved_program[j];
-                }
-                return (uint32_t)-5; /* Failed to execute */
-            }
-
-            /* Restore caller's memory after program exits */
-            for (uint32_t j = 0; j < save_size; j++) {
-                program_base[j] = saved_program[j];
+            /* Execute the binary in its own address space (pages come from
+             * file); its descriptors and async I/O go away when it exits,
+             * while the caller's queued requests wait for the caller */
+            int result = elf_load_and_exec(program_name, file);
+            if (result != 0) {
+                return (uint32_t)result; /* ELF_ERR_* */
             }
 
             return 0; /* Success */
@@ -266,8 +215,14 @@ uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uin
         }
 
         case SYSCALL_SLEEP: {
-            /* arg1 = milliseconds to sleep */
-            sleep_ms(arg1);
+            /* arg1 = milliseconds to sleep; queued async I/O runs first */
+            uint32_t until = get_uptime_ms() + arg1;
+            while (get_uptime_ms() < until && aio_poll()) { }
+
+            while (get_uptime_ms() < until) {
+                process_yield();
+                __asm__ volatile("hlt");
+            }
             return 0;
         }
 
@@ -277,11 +232,34 @@ uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uin
         }
 
         case SYSCALL_MEMINFO: {
-            /* arg1: 0=free pages, 1=total pages, 2=page size */
+            /* arg1: 0=free pages, 1=total pages, 2=page size, 3=page cache pages,
+             * 4=tmpfs pages, 5=allocated pages */
             switch (arg1) {
                 case 0: return pmm_get_free_count();
                 case 1: return pmm_get_total_count();
                 case 2: return PAGE_SIZE;
+                case 3: {
+                    pagecache_stats_t pc;
+                    pagecache_get_stats(&pc);
+                    return pc.pages;
+                }
+                case 4: return tmpfs_used_pages();
+                case 5: return pmm_get_used_count();
+                default: return (uint32_t)-1;
+            }
+        }
+
+        case SYSCALL_EXEC_STATS: {
+            /* arg1: 0=hits, 1=misses, 2=cached images, 3=prepared pages,
+             * 4=bytes in use */
+            execcache_stats_t ec;
+            execcache_get_stats(&ec);
+            switch (arg1) {
+                case 0: return ec.hits;
+                case 1: return ec.misses;
+                case 2: return ec.images;
+                case 3: return ec.pages;
+                case 4: return ec.bytes;
                 default: return (uint32_t)-1;
             }
         }
@@ -303,6 +281,89 @@ uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uin
             return cur ? cur->pid : 0;
         }
 
+        case SYSCALL_FORK: {
+            /* Returns the child's pid, 0 in the child, -1 on failure */
+            process_t *cur = process_get_current();
+            if (!cur || !cur->image) {
+                return (uint32_t)-1;
+            }
+            vfs_file_t *file = vfs_dup(cur->image_file);
+            program_args_t *args = 0;
+            if (cur->args) {
+                args = (program_args_t *)kmalloc(sizeof(program_args_t));
+                if (args) {
+                    *args = *cur->args;
+                }
+            }
+            uint32_t *space = (file && (args || !cur->args)) ?
+                              paging_clone_space(current_page_directory) : 0;
+            process_t *child = space ? process_fork(space) : 0;
+            if (!child) {
+                if (space) paging_destroy_space(space);
+                if (file) vfs_close(file);
+                if (args) kfree(args);
+                return (uint32_t)-1;
+            }
+
+            /* The child demand-pages from the same image */
+            execcache_get(cur->image);
+            child->image = cur->image;
+            child->image_file = file;
+            child->args = args;
+            file_inherit(child, cur);
+            process_wake(child);
+            return child->pid;
+        }
+
+        case SYSCALL_SPAWN: {
+            /* arg1 = command string pointer; returns the child's pid at once */
+            const char *cmd = (const char *)arg1;
+            if (!paging_user_string(cmd)) {
+                return (uint32_t)-1;
+            }
+
+            program_args_t *args = (program_args_t *)kmalloc(sizeof(program_args_t));
+            if (!args) {
+                return (uint32_t)ELF_ERR_LOAD;
+            }
+            char program_name[64];
+            parse_command_line(cmd, program_name, args);
+
+            vfs_file_t *file = elf_open(program_name);
+            if (!file) {
+                kfree(args);
+                return (uint32_t)-1; /* File not found */
+            }
+
+            int pid = elf_spawn(program_name, file, args);
+            if (pid < 0) {
+                kfree(args);
+            }
+            return (uint32_t)pid;
+        }
+
+        case SYSCALL_WAITPID: {
+            /* arg1 = pid (-1 = any child), arg2 = exit code pointer or NULL,
+             * arg3 = WNOHANG to poll; returns the pid collected, 0 if none
+             * has exited yet (WNOHANG), -1 if there is no such child */
+            if (arg2 && !paging_user_range(arg2, sizeof(int))) {
+                return (uint32_t)-1;
+            }
+            return (uint32_t)process_wait((int)arg1, (int *)arg2, arg3 & WNOHANG);
+        }
+
+        case SYSCALL_BRK:
+            /* arg1 = new program break (0 = query); returns the break in effect */
+            return mman_brk(arg1);
+
+        case SYSCALL_MMAP:
+            /* arg1 = length; returns zero-filled anonymous memory, or 0 */
+            return mman_map(arg1);
+
+        case SYSCALL_MUNMAP:
+            /* arg1 = page-aligned address, arg2 = length */
+            return (uint32_t)mman_unmap(arg1, arg2);
+
         default:
             vga_puts("[Unknown syscall]\n");
             return (uint32_t)-1;
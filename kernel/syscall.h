@@ -19,9 +19,25 @@
 #define SYSCALL_MEMINFO    13
 #define SYSCALL_HEAP_STATS 14
 #define SYSCALL_GETPID     15
+#define SYSCALL_FADVISE    16
+#define SYSCALL_AIO_SETUP  17
+#define SYSCALL_AIO_ENTER  18
+#define SYSCALL_FILE_WRITE 19
+#define SYSCALL_UNLINK     20
+#define SYSCALL_EXEC_STATS 21
+#define SYSCALL_FORK       22
+#define SYSCALL_SPAWN      23
+#define SYSCALL_WAITPID    24
+#define SYSCALL_BRK        25
+#define SYSCALL_MMAP       26
+#define SYSCALL_MUNMAP     27
+
+/* waitpid options */
+#define WNOHANG            1
 
 /* Syscall handler */
-uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+uint32_t syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_t arg3,
+                         uint32_t arg4);
 
 /* Initialize syscalls */
 void syscall_init(void);
@@ -0,0 +1,288 @@
+#include "tmpfs.h"
+#include "pmm.h"
+#include "heap.h"
+
+static tmpfs_node_t *dir[TMPFS_DIR_HASH];
+static uint32_t max_pages = 0;
+static uint32_t used_pages = 0;
+static uint32_t next_ino = 1;
+
+/* Memory functions */
+static void* memcpy(void* dest, const void* src, uint32_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    while (n--) *d++ = *s++;
+    return dest;
+}
+
+static void* memset(void* s, int c, uint32_t n) {
+    uint8_t* p = (uint8_t*)s;
+    while (n--) *p++ = (uint8_t)c;
+    return s;
+}
+
+static int streq(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+/* FNV-1a over the name */
+static uint32_t name_hash(const char *name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h % TMPFS_DIR_HASH;
+}
+
+static tmpfs_node_t *dir_lookup(const char *name) {
+    tmpfs_node_t *n = dir[name_hash(name)];
+    while (n && !streq(n->name, name))
+        n = n->next;
+    return n;
+}
+
+static void dir_remove(tmpfs_node_t *node) {
+    tmpfs_node_t **link = &dir[name_hash(node->name)];
+    while (*link != node)
+        link = &(*link)->next;
+    *link = node->next;
+}
+
+/* Release every data page of a node */
+static void free_pages(tmpfs_node_t *node) {
+    for (uint32_t i = 0; i < node->page_slots; i++) {
+        if (node->pages[i]) {
+            pmm_free(node->pages[i]);
+            node->pages[i] = 0;
+            used_pages--;
+        }
+    }
+    node->size = 0;
+}
+
+static void free_node(tmpfs_node_t *node) {
+    free_pages(node);
+    if (node->pages)
+        kfree(node->pages);
+    kfree(node);
+}
+
+/* Make room for page index `index` in the node's page array */
+static int grow_slots(tmpfs_node_t *node, uint32_t index) {
+    if (index < node->page_slots)
+        return 0;
+
+    uint32_t slots = node->page_slots ? node->page_slots : 4;
+    while (slots <= index)
+        slots *= 2;
+
+    uint32_t *pages = (uint32_t *)kmalloc(slots * sizeof(uint32_t));
+    if (!pages)
+        return -1;
+    for (uint32_t i = 0; i < slots; i++)
+        pages[i] = i < node->page_slots ? node->pages[i] : 0;
+
+    if (node->pages)
+        kfree(node->pages);
+    node->pages = pages;
+    node->page_slots = slots;
+    return 0;
+}
+
+void tmpfs_init(uint32_t pages) {
+    for (int i = 0; i < TMPFS_DIR_HASH; i++)
+        dir[i] = 0;
+    max_pages = pages;
+    used_pages = 0;
+}
+
+static int tmpfs_lookup(vfs_mount_t *mnt, const char *name, vnode_t *vn) {
+    (void)mnt;
+    tmpfs_node_t *node = dir_lookup(name);
+    if (!node)
+        return -1;
+    vn->ino = node->ino;
+    vn->data = node;
+    vn->size = node->size;
+    return 0;
+}
+
+static int tmpfs_create(vfs_mount_t *mnt, const char *name, vnode_t *vn) {
+    (void)mnt;
+    uint32_t len = 0;
+    while (name[len])
+        len++;
+    if (len == 0 || len > TMPFS_NAME_MAX)
+        return -1;
+
+    tmpfs_node_t *node = (tmpfs_node_t *)kmalloc(sizeof(tmpfs_node_t));
+    if (!node)
+        return -1;
+    memcpy(node->name, name, len + 1);
+    node->ino = next_ino++;
+    node->size = 0;
+    node->pages = 0;
+    node->page_slots = 0;
+    node->open_count = 0;
+    node->unlinked = 0;
+
+    uint32_t h = name_hash(name);
+    node->next = dir[h];
+    dir[h] = node;
+
+    vn->ino = node->ino;
+    vn->data = node;
+    vn->size = 0;
+    return 0;
+}
+
+static void *tmpfs_open(vnode_t *vn, uint32_t flags) {
+    tmpfs_node_t *node = (tmpfs_node_t *)vn->data;
+
+    tmpfs_file_t *file = (tmpfs_file_t *)kmalloc(sizeof(tmpfs_file_t));
+    if (!file)
+        return 0;
+    if (flags & O_TRUNC) {
+        free_pages(node);
+        vn->size = 0;
+    }
+    file->node = node;
+    file->position = 0;
+    node->open_count++;
+    return file;
+}
+
+static int tmpfs_read(vfs_file_t *vf, uint8_t *buffer, uint32_t size) {
+    tmpfs_file_t *file = (tmpfs_file_t *)vf->handle;
+    tmpfs_node_t *node = file->node;
+    uint32_t bytes_read = 0;
+
+    if (file->position >= node->size)
+        return 0;
+    if (size > node->size - file->position)
+        size = node->size - file->position;
+
+    while (bytes_read < size) {
+        uint32_t index = file->position / PAGE_SIZE;
+        uint32_t offset = file->position % PAGE_SIZE;
+        uint32_t chunk = PAGE_SIZE - offset;
+        if (chunk > size - bytes_read)
+            chunk = size - bytes_read;
+
+        uint32_t frame = index < node->page_slots ? node->pages[index] : 0;
+        if (frame)
+            memcpy(buffer + bytes_read, (uint8_t *)frame + offset, chunk);
+        else
+            memset(buffer + bytes_read, 0, chunk);
+
+        bytes_read += chunk;
+        file->position += chunk;
+    }
+    return (int)bytes_read;
+}
+
+static int tmpfs_write(vfs_file_t *vf, const uint8_t *buffer, uint32_t size) {
+    tmpfs_file_t *file = (tmpfs_file_t *)vf->handle;
+    tmpfs_node_t *node = file->node;
+    uint32_t written = 0;
+
+    while (written < size) {
+        uint32_t index = file->position / PAGE_SIZE;
+        uint32_t offset = file->position % PAGE_SIZE;
+        uint32_t chunk = PAGE_SIZE - offset;
+        if (chunk > size - written)
+            chunk = size - written;
+
+        if (grow_slots(node, index) != 0)
+            break;
+
+        if (!node->pages[index]) {
+            if (used_pages >= max_pages)
+                break;
+            uint32_t frame = pmm_alloc();
+            if (!frame)
+                break;
+            memset((uint8_t *)frame, 0, PAGE_SIZE);
+            node->pages[index] = frame;
+            used_pages++;
+        }
+
+        memcpy((uint8_t *)node->pages[index] + offset, buffer + written, chunk);
+        written += chunk;
+        file->position += chunk;
+        if (file->position > node->size)
+            node->size = file->position;
+    }
+    vf->vnode->size = node->size;
+
+    if (written == 0 && size > 0)
+        return -1;
+    return (int)written;
+}
+
+static int tmpfs_seek(vfs_file_t *vf, uint32_t offset) {
+    ((tmpfs_file_t *)vf->handle)->position = offset;
+    return 0;
+}
+
+static uint32_t tmpfs_tell(vfs_file_t *vf) {
+    return ((tmpfs_file_t *)vf->handle)->position;
+}
+
+static void tmpfs_close(vfs_file_t *vf) {
+    tmpfs_file_t *file = (tmpfs_file_t *)vf->handle;
+    tmpfs_node_t *node = file->node;
+    kfree(file);
+
+    if (--node->open_count == 0 && node->unlinked)
+        free_node(node);
+}
+
+static int tmpfs_unlink(vnode_t *vn) {
+    tmpfs_node_t *node = (tmpfs_node_t *)vn->data;
+
+    dir_remove(node);
+    if (node->open_count == 0)
+        free_node(node);
+    else
+        node->unlinked = 1;
+    return 0;
+}
+
+static int tmpfs_readdir(vfs_mount_t *mnt, vfs_dirent_t *entries, int max_entries) {
+    (void)mnt;
+    int count = 0;
+    for (int i = 0; i < TMPFS_DIR_HASH && count < max_entries; i++) {
+        for (tmpfs_node_t *n = dir[i]; n && count < max_entries; n = n->next) {
+            memcpy(entries[count].name, n->name, TMPFS_NAME_MAX + 1);
+            entries[count].size = n->size;
+            entries[count].is_directory = 0;
+            count++;
+        }
+    }
+    return count;
+}
+
+uint32_t tmpfs_used_pages(void) {
+    return used_pages;
+}
+
+const vfs_ops_t tmpfs_ops = {
+    .name = "tmpfs",
+    .lookup = tmpfs_lookup,
+    .create = tmpfs_create,
+    .open = tmpfs_open,
+    .read = tmpfs_read,
+    .write = tmpfs_write,
+    .seek = tmpfs_seek,
+    .tell = tmpfs_tell,
+    .advise = 0,
+    .close = tmpfs_close,
+    .unlink = tmpfs_unlink,
+    .readdir = tmpfs_readdir,
+};
@@ -0,0 +1,40 @@
+#ifndef TMPFS_H
+#define TMPFS_H
+
+#include <stdint.h>
+#include "vfs.h"
+
+/*
+ * tmpfs: RAM-backed flat directory, mounted at /tmp. File data lives in
+ * whole PMM pages referenced from a per-file page array; names are found
+ * through a hashed directory. Total size is capped at init time.
+ */
+
+#define TMPFS_NAME_MAX   VFS_NAME_MAX
+#define TMPFS_DIR_HASH   32
+
+typedef struct tmpfs_node {
+    char name[TMPFS_NAME_MAX + 1];
+    uint32_t ino;
+    uint32_t size;
+    uint32_t *pages;            /* Frame per page index, 0 = hole */
+    uint32_t page_slots;        /* Capacity of pages[] */
+    uint32_t open_count;
+    uint8_t unlinked;           /* Freed on last close */
+    struct tmpfs_node *next;    /* Directory hash chain */
+} tmpfs_node_t;
+
+typedef struct {
+    tmpfs_node_t *node;
+    uint32_t position;
+} tmpfs_file_t;
+
+/* Reset to an empty tmpfs allowed to hold at most max_pages pages of data */
+void tmpfs_init(uint32_t max_pages);
+
+/* Pages currently holding file data */
+uint32_t tmpfs_used_pages(void);
+
+extern const vfs_ops_t tmpfs_ops;
+
+#endif /* TMPFS_H */
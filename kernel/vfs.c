@@ -0,0 +1,345 @@
+#include "vfs.h"
+#include "slab.h"
+#include "execcache.h"
+
+static vfs_mount_t mounts[VFS_MAX_MOUNTS];
+static int mount_count = 0;
+
+/* Vnode cache: hashed by (mount, name), unreferenced vnodes on an LRU list */
+static vnode_t *vnode_hash[VFS_VNODE_HASH];
+static vnode_t *lru_head = 0;
+static vnode_t *lru_tail = 0;
+static uint32_t lru_count = 0;
+
+/* Fields a vnode starts with before the driver fills it in */
+static void vnode_ctor(void *obj) {
+    vnode_t *vn = (vnode_t *)obj;
+    vn->ino = 0;
+    vn->size = 0;
+    vn->is_directory = 0;
+    vn->unlinked = 0;
+    vn->data = 0;
+    vn->lru_prev = 0;
+    vn->lru_next = 0;
+}
+
+static slab_cache_t vnode_cache = SLAB_CACHE("vnode", sizeof(vnode_t), vnode_ctor);
+static slab_cache_t file_cache = SLAB_CACHE("vfs_file", sizeof(vfs_file_t), 0);
+
+static int streq(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+/* FNV-1a over the name, seeded with the mount */
+static uint32_t vnode_hash_of(vfs_mount_t *mnt, const char *name) {
+    uint32_t h = 2166136261u ^ (uint32_t)(mnt - mounts);
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h % VFS_VNODE_HASH;
+}
+
+static void lru_remove(vnode_t *vn) {
+    if (vn->lru_prev) {
+        vn->lru_prev->lru_next = vn->lru_next;
+    } else {
+        lru_head = vn->lru_next;
+    }
+    if (vn->lru_next) {
+        vn->lru_next->lru_prev = vn->lru_prev;
+    } else {
+        lru_tail = vn->lru_prev;
+    }
+    vn->lru_prev = 0;
+    vn->lru_next = 0;
+    lru_count--;
+}
+
+static void lru_append(vnode_t *vn) {
+    vn->lru_prev = lru_tail;
+    vn->lru_next = 0;
+    if (lru_tail) {
+        lru_tail->lru_next = vn;
+    } else {
+        lru_head = vn;
+    }
+    lru_tail = vn;
+    lru_count++;
+}
+
+static void hash_remove(vnode_t *vn) {
+    vnode_t **link = &vnode_hash[vnode_hash_of(vn->mount, vn->name)];
+    while (*link != vn) {
+        link = &(*link)->hash_next;
+    }
+    *link = vn->hash_next;
+}
+
+/* Take a reference on the vnode for name, looking it up (or creating it) on a miss */
+static vnode_t *vnode_get(vfs_mount_t *mnt, const char *name, uint32_t flags) {
+    uint32_t h = vnode_hash_of(mnt, name);
+
+    for (vnode_t *vn = vnode_hash[h]; vn; vn = vn->hash_next) {
+        if (vn->mount == mnt && streq(vn->name, name)) {
+            if (vn->refcount++ == 0) {
+                lru_remove(vn);
+            }
+            return vn;
+        }
+    }
+
+    vnode_t *vn = (vnode_t *)slab_alloc(&vnode_cache);
+    if (!vn) {
+        return 0;
+    }
+
+    int i;
+    for (i = 0; name[i]; i++) {
+        vn->name[i] = name[i];
+    }
+    vn->name[i] = '\0';
+    vn->mount = mnt;
+
+    if (mnt->ops->lookup(mnt, vn->name, vn) != 0 &&
+        (!(flags & O_CREAT) || !mnt->ops->create ||
+         mnt->ops->create(mnt, vn->name, vn) != 0)) {
+        slab_free(&vnode_cache, vn);
+        return 0;
+    }
+
+    vn->refcount = 1;
+    vn->hash_next = vnode_hash[h];
+    vnode_hash[h] = vn;
+    return vn;
+}
+
+/* Drop a reference; idle vnodes stay cached until the LRU overflows */
+static void vnode_put(vnode_t *vn) {
+    if (--vn->refcount > 0) {
+        return;
+    }
+
+    if (vn->unlinked) {
+        slab_free(&vnode_cache, vn);
+        return;
+    }
+
+    lru_append(vn);
+    if (lru_count > VFS_VNODE_CACHE) {
+        vnode_t *old = lru_head;
+        lru_remove(old);
+        hash_remove(old);
+        slab_free(&vnode_cache, old);
+    }
+}
+
+/*
+ * Split path into its mount and the name within it. The longest mount
+ * point that prefixes the path wins; name is "" for the mount's root.
+ */
+static vfs_mount_t *vfs_resolve(const char *path, char *name) {
+    vfs_mount_t *best = 0;
+    int best_len = -1;
+
+    if (!path) {
+        path = "/";
+    }
+
+    for (int m = 0; m < mount_count; m++) {
+        const char *mp = mounts[m].path;
+        int len = 0;
+
+        /* "/" matches everything, including relative paths */
+        if (!(mp[0] == '/' && mp[1] == '\0')) {
+            while (mp[len] && mp[len] == path[len]) {
+                len++;
+            }
+            if (mp[len] || (path[len] != '\0' && path[len] != '/')) {
+                continue;
+            }
+        }
+        if (len > best_len) {
+            best = &mounts[m];
+            best_len = len;
+        }
+    }
+    if (!best) {
+        return 0;
+    }
+
+    path += best_len;
+    while (*path == '/') {
+        path++;
+    }
+
+    int i;
+    for (i = 0; path[i]; i++) {
+        char ch = path[i];
+        if (ch == '/' || i == VFS_NAME_MAX) {
+            return 0;  /* No subdirectories */
+        }
+        if ((best->flags & VFS_CASEFOLD) && ch >= 'a' && ch <= 'z') {
+            ch -= 32;
+        }
+        name[i] = ch;
+    }
+    name[i] = '\0';
+    return best;
+}
+
+int vfs_mount(const char *path, const vfs_ops_t *ops, void *data, uint32_t flags) {
+    if (!path || !ops || mount_count == VFS_MAX_MOUNTS) {
+        return -1;
+    }
+
+    vfs_mount_t *mnt = &mounts[mount_count];
+    int i;
+    for (i = 0; path[i]; i++) {
+        if (i == VFS_PATH_MAX - 1) {
+            return -1;
+        }
+        mnt->path[i] = path[i];
+    }
+    mnt->path[i] = '\0';
+    mnt->ops = ops;
+    mnt->data = data;
+    mnt->flags = flags;
+    mount_count++;
+    return 0;
+}
+
+vfs_file_t *vfs_open(const char *path, uint32_t flags) {
+    char name[VFS_NAME_MAX + 1];
+    vfs_mount_t *mnt = vfs_resolve(path, name);
+    if (!mnt || !name[0]) {
+        return 0;
+    }
+    if ((flags & O_TRUNC) && !mnt->ops->write) {
+        return 0;
+    }
+
+    vnode_t *vn = vnode_get(mnt, name, flags);
+    if (!vn) {
+        return 0;
+    }
+    if (flags & O_TRUNC) {
+        execcache_invalidate(mnt, vn->ino);
+    }
+
+    vfs_file_t *file = (vfs_file_t *)slab_alloc(&file_cache);
+    if (!file) {
+        vnode_put(vn);
+        return 0;
+    }
+    file->vnode = vn;
+    file->handle = mnt->ops->open(vn, flags);
+    if (!file->handle) {
+        slab_free(&file_cache, file);
+        vnode_put(vn);
+        return 0;
+    }
+    return file;
+}
+
+int vfs_read(vfs_file_t *file, uint8_t *buffer, uint32_t size) {
+    if (!file || !buffer) {
+        return -1;
+    }
+    return file->vnode->mount->ops->read(file, buffer, size);
+}
+
+int vfs_write(vfs_file_t *file, const uint8_t *buffer, uint32_t size) {
+    if (!file || !buffer || !file->vnode->mount->ops->write) {
+        return -1;
+    }
+    execcache_invalidate(file->vnode->mount, file->vnode->ino);
+    return file->vnode->mount->ops->write(file, buffer, size);
+}
+
+int vfs_seek(vfs_file_t *file, uint32_t offset) {
+    if (!file || !file->vnode->mount->ops->seek || offset > file->vnode->size) {
+        return -1;
+    }
+    return file->vnode->mount->ops->seek(file, offset);
+}
+
+int vfs_advise(vfs_file_t *file, uint32_t offset, uint32_t len, int advice) {
+    if (!file) {
+        return -1;
+    }
+    if (!file->vnode->mount->ops->advise) {
+        return 0;  /* Nothing to tune */
+    }
+    return file->vnode->mount->ops->advise(file, offset, len, advice);
+}
+
+void vfs_close(vfs_file_t *file) {
+    if (!file) {
+        return;
+    }
+    vnode_t *vn = file->vnode;
+    vn->mount->ops->close(file);
+    slab_free(&file_cache, file);
+    vnode_put(vn);
+}
+
+vfs_file_t *vfs_dup(vfs_file_t *file) {
+    if (!file) {
+        return 0;
+    }
+    vnode_t *vn = file->vnode;
+
+    vfs_file_t *copy = (vfs_file_t *)slab_alloc(&file_cache);
+    if (!copy) {
+        return 0;
+    }
+    copy->vnode = vn;
+    copy->handle = vn->mount->ops->open(vn, 0);
+    if (!copy->handle) {
+        slab_free(&file_cache, copy);
+        return 0;
+    }
+    vn->refcount++;
+    if (vn->mount->ops->tell && vn->mount->ops->seek) {
+        vn->mount->ops->seek(copy, vn->mount->ops->tell(file));
+    }
+    return copy;
+}
+
+int vfs_unlink(const char *path) {
+    char name[VFS_NAME_MAX + 1];
+    vfs_mount_t *mnt = vfs_resolve(path, name);
+    if (!mnt || !name[0] || !mnt->ops->unlink) {
+        return -1;
+    }
+
+    vnode_t *vn = vnode_get(mnt, name, 0);
+    if (!vn) {
+        return -1;
+    }
+    if (mnt->ops->unlink(vn) != 0) {
+        vnode_put(vn);
+        return -1;
+    }
+    execcache_invalidate(mnt, vn->ino);
+
+    /* Later lookups must miss; open files keep the vnode alive */
+    hash_remove(vn);
+    vn->unlinked = 1;
+    vnode_put(vn);
+    return 0;
+}
+
+int vfs_readdir(const char *path, vfs_dirent_t *entries, int max_entries) {
+    char name[VFS_NAME_MAX + 1];
+    vfs_mount_t *mnt = vfs_resolve(path, name);
+    if (!mnt || name[0] || !entries || max_entries <= 0) {
+        return -1;
+    }
+    return mnt->ops->readdir(mnt, entries, max_entries);
+}
@@ -0,0 +1,111 @@
+#ifndef VFS_H
+#define VFS_H
+
+#include <stdint.h>
+
+/*
+ * Virtual filesystem: a mount table maps path prefixes to filesystem
+ * drivers, each described by an operation table. Names resolve to vnodes
+ * held in a cache shared by all mounts; a vnode stays cached after its
+ * last reference is dropped so repeated opens skip the driver lookup.
+ * Filesystems are flat (one directory per mount).
+ */
+
+#define VFS_MAX_MOUNTS   4
+#define VFS_PATH_MAX     16     /* Mount point, including terminator */
+#define VFS_NAME_MAX     12     /* 8.3 names */
+#define VFS_VNODE_HASH   64
+#define VFS_VNODE_CACHE  64     /* Unreferenced vnodes kept for reuse */
+
+/* Open flags */
+#define O_CREAT          0x01
+#define O_TRUNC          0x02
+
+/* Access pattern hints (vfs_advise) */
+#define FADV_NORMAL      0  /* Readahead grows while reads stay sequential */
+#define FADV_RANDOM      1  /* No readahead */
+#define FADV_SEQUENTIAL  2  /* Full readahead window from the first read */
+#define FADV_WILLNEED    3  /* Prefetch the range now */
+#define FADV_DONTNEED    4  /* Drop the range from the page cache */
+
+/* Mount flags */
+#define VFS_CASEFOLD     0x01   /* Names are case-insensitive, stored upper-case */
+
+/* Directory entry (layout shared with userspace dirinfo_t) */
+typedef struct {
+    char name[13];
+    uint32_t size;
+    uint8_t is_directory;
+} vfs_dirent_t;
+
+struct vfs_mount;
+
+typedef struct vnode {
+    struct vfs_mount *mount;
+    char name[VFS_NAME_MAX + 1];
+    uint32_t ino;               /* Driver inode number */
+    uint32_t size;
+    uint8_t is_directory;
+    uint8_t unlinked;           /* Out of the cache, freed on last put */
+    uint32_t refcount;
+    void *data;                 /* Driver inode */
+    struct vnode *hash_next;
+    struct vnode *lru_prev;     /* Unreferenced vnodes, oldest first */
+    struct vnode *lru_next;
+} vnode_t;
+
+typedef struct vfs_file {
+    vnode_t *vnode;
+    void *handle;               /* Driver per-open state */
+} vfs_file_t;
+
+/* Filesystem driver; NULL create/write/unlink make a read-only filesystem */
+typedef struct {
+    const char *name;
+    /* Find name and fill vn->ino/size/is_directory/data, 0 or -1 */
+    int (*lookup)(struct vfs_mount *mnt, const char *name, vnode_t *vn);
+    int (*create)(struct vfs_mount *mnt, const char *name, vnode_t *vn);
+    /* Returns per-open state or NULL */
+    void *(*open)(vnode_t *vn, uint32_t flags);
+    int (*read)(vfs_file_t *file, uint8_t *buffer, uint32_t size);
+    int (*write)(vfs_file_t *file, const uint8_t *buffer, uint32_t size);
+    /* Move the file position (offset <= size), 0 or -1 */
+    int (*seek)(vfs_file_t *file, uint32_t offset);
+    /* Current file position */
+    uint32_t (*tell)(vfs_file_t *file);
+    int (*advise)(vfs_file_t *file, uint32_t offset, uint32_t len, int advice);
+    void (*close)(vfs_file_t *file);
+    int (*unlink)(vnode_t *vn);
+    int (*readdir)(struct vfs_mount *mnt, vfs_dirent_t *entries, int max_entries);
+} vfs_ops_t;
+
+typedef struct vfs_mount {
+    char path[VFS_PATH_MAX];
+    const vfs_ops_t *ops;
+    void *data;                 /* Driver superblock */
+    uint32_t flags;
+} vfs_mount_t;
+
+/* Attach a filesystem at path, returns 0 or -1 */
+int vfs_mount(const char *path, const vfs_ops_t *ops, void *data, uint32_t flags);
+
+/* Open by path (relative paths start at "/"), returns NULL on failure */
+vfs_file_t *vfs_open(const char *path, uint32_t flags);
+
+int vfs_read(vfs_file_t *file, uint8_t *buffer, uint32_t size);
+int vfs_write(vfs_file_t *file, const uint8_t *buffer, uint32_t size);
+int vfs_seek(vfs_file_t *file, uint32_t offset);
+int vfs_advise(vfs_file_t *file, uint32_t offset, uint32_t len, int advice);
+void vfs_close(vfs_file_t *file);
+
+/* Open the same file again with its own position, starting where file
+ * stands now; NULL on failure */
+vfs_file_t *vfs_dup(vfs_file_t *file);
+
+/* Remove a file; open descriptors keep working until closed */
+int vfs_unlink(const char *path);
+
+/* List the directory of the mount at path (NULL = "/") */
+int vfs_readdir(const char *path, vfs_dirent_t *entries, int max_entries);
+
+#endif /* VFS_H */
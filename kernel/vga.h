@@ -27,7 +27,7 @@ enum vga_color {
 /* VGA text mode constants */
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
-#define VGA_MEMORY 0xB8000
+#define VGA_MEMORY 0xC00B8000     /* 0xB8000 through the kernel direct map */
 
 /* Initialize VGA */
 void vga_init(void);
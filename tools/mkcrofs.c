@@ -0,0 +1,264 @@
+/*
+ * mkcrofs - build a crofs image (see kernel/crofs.h) on the host.
+ *
+ * usage: mkcrofs <image> [NAME=]<file>...
+ *
+ * Each file is cut into 4KB blocks that are LZ4-compressed independently;
+ * blocks that do not shrink are stored as-is. Names default to the upper-
+ * cased basename of the file.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Must match kernel/crofs.h */
+#define CROFS_MAGIC       0x53465243
+#define CROFS_VERSION     1
+#define CROFS_BLOCK_SIZE  4096
+#define CROFS_NAME_MAX    15
+#define NAME_MAX_VFS      12        /* kernel VFS_NAME_MAX */
+#define SECTOR_SIZE       512
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t file_count;
+    uint32_t total_blocks;
+    uint32_t meta_size;
+    uint32_t image_size;
+} __attribute__((packed)) crofs_super_t;
+
+typedef struct {
+    char name[CROFS_NAME_MAX + 1];
+    uint32_t size;
+    uint32_t first_block;
+    uint32_t block_count;
+    uint32_t reserved;
+} __attribute__((packed)) crofs_dirent_t;
+
+typedef struct {
+    uint8_t *data;
+    uint32_t len;
+} block_t;
+
+#define HASH_BITS 12
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static int put_length(uint8_t *dst, int op, int cap, uint32_t len) {
+    while (len >= 255) {
+        if (op >= cap) return -1;
+        dst[op++] = 255;
+        len -= 255;
+    }
+    if (op >= cap) return -1;
+    dst[op++] = (uint8_t)len;
+    return op;
+}
+
+/* Emit one sequence; match_len 0 means trailing literals only */
+static int put_sequence(uint8_t *dst, int op, int cap, const uint8_t *lit, uint32_t lit_len,
+                        uint32_t distance, uint32_t match_len) {
+    uint32_t ml = match_len ? match_len - 4 : 0;
+    if (op >= cap) return -1;
+    dst[op++] = (uint8_t)(((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+    if (lit_len >= 15 && (op = put_length(dst, op, cap, lit_len - 15)) < 0) return -1;
+    if (op + (int)lit_len > cap) return -1;
+    memcpy(dst + op, lit, lit_len);
+    op += lit_len;
+    if (!match_len) return op;
+    if (op + 2 > cap) return -1;
+    dst[op++] = (uint8_t)distance;
+    dst[op++] = (uint8_t)(distance >> 8);
+    if (ml >= 15 && (op = put_length(dst, op, cap, ml - 15)) < 0) return -1;
+    return op;
+}
+
+/*
+ * Greedy LZ4 block compressor. Follows the format's end-of-block rules
+ * (last 5 bytes are literals, no match starts in the last 12). Returns the
+ * compressed size, or -1 if it would not fit in cap bytes.
+ */
+static int lz4_compress(const uint8_t *src, int n, uint8_t *dst, int cap) {
+    int table[1 << HASH_BITS];
+    int anchor = 0, ip = 0, op = 0;
+    int mflimit = n - 12;
+    int matchlimit = n - 5;
+
+    for (int i = 0; i < (1 << HASH_BITS); i++) table[i] = -1;
+
+    while (ip < mflimit) {
+        uint32_t seq = read32(src + ip);
+        uint32_t h = (seq * 2654435761u) >> (32 - HASH_BITS);
+        int ref = table[h];
+        table[h] = ip;
+
+        if (ref < 0 || ip - ref > 65535 || read32(src + ref) != seq) {
+            ip++;
+            continue;
+        }
+
+        int len = 4;
+        while (ip + len < matchlimit && src[ref + len] == src[ip + len]) len++;
+
+        op = put_sequence(dst, op, cap, src + anchor, ip - anchor, ip - ref, len);
+        if (op < 0) return -1;
+        ip += len;
+        anchor = ip;
+    }
+
+    return put_sequence(dst, op, cap, src + anchor, n - anchor, 0, 0);
+}
+
+static uint8_t *read_file(const char *path, uint32_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(len ? len : 1);
+    if (buf && fread(buf, 1, len, f) != (size_t)len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *size = (uint32_t)len;
+    return buf;
+}
+
+/* NAME=path, or the basename of path upper-cased */
+static int parse_name(const char *arg, char *name, const char **path) {
+    const char *eq = strchr(arg, '=');
+    const char *src;
+    size_t len;
+
+    if (eq) {
+        src = arg;
+        len = eq - arg;
+        *path = eq + 1;
+    } else {
+        const char *slash = strrchr(arg, '/');
+        src = slash ? slash + 1 : arg;
+        len = strlen(src);
+        *path = arg;
+    }
+    if (len == 0 || len > NAME_MAX_VFS) return -1;
+
+    for (size_t i = 0; i < len; i++) {
+        char ch = src[i];
+        name[i] = (ch >= 'a' && ch <= 'z') ? ch - 32 : ch;
+    }
+    name[len] = '\0';
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image> [NAME=]<file>...\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t file_count = argc - 2;
+    crofs_dirent_t *dir = calloc(file_count, sizeof(crofs_dirent_t));
+    block_t *blocks = NULL;
+    uint32_t total_blocks = 0;
+    uint32_t raw_total = 0;
+    uint8_t packed[CROFS_BLOCK_SIZE];
+
+    for (uint32_t i = 0; i < file_count; i++) {
+        const char *path;
+        uint32_t size;
+
+        if (parse_name(argv[i + 2], dir[i].name, &path) != 0) {
+            fprintf(stderr, "mkcrofs: bad name for %s (1-%d chars)\n", argv[i + 2], NAME_MAX_VFS);
+            return 1;
+        }
+        for (uint32_t j = 0; j < i; j++) {
+            if (strcmp(dir[j].name, dir[i].name) == 0) {
+                fprintf(stderr, "mkcrofs: duplicate name %s\n", dir[i].name);
+                return 1;
+            }
+        }
+
+        uint8_t *data = read_file(path, &size);
+        if (!data) {
+            fprintf(stderr, "mkcrofs: cannot read %s\n", path);
+            return 1;
+        }
+
+        dir[i].size = size;
+        dir[i].first_block = total_blocks;
+        dir[i].block_count = (size + CROFS_BLOCK_SIZE - 1) / CROFS_BLOCK_SIZE;
+        blocks = realloc(blocks, (total_blocks + dir[i].block_count) * sizeof(block_t));
+
+        uint32_t stored = 0;
+        for (uint32_t b = 0; b < dir[i].block_count; b++) {
+            uint32_t off = b * CROFS_BLOCK_SIZE;
+            uint32_t len = size - off < CROFS_BLOCK_SIZE ? size - off : CROFS_BLOCK_SIZE;
+            int clen = lz4_compress(data + off, len, packed, len - 1);
+            block_t *blk = &blocks[total_blocks++];
+
+            /* Equal length marks an uncompressed block */
+            blk->len = clen > 0 ? (uint32_t)clen : len;
+            blk->data = malloc(blk->len);
+            memcpy(blk->data, clen > 0 ? packed : data + off, blk->len);
+            stored += blk->len;
+        }
+
+        printf("  %-12s %7u -> %7u bytes\n", dir[i].name, size, stored);
+        raw_total += size;
+        free(data);
+    }
+
+    /* Metadata right after the superblock sector, then the blocks */
+    crofs_super_t super;
+    memset(&super, 0, sizeof(super));
+    super.magic = CROFS_MAGIC;
+    super.version = CROFS_VERSION;
+    super.block_size = CROFS_BLOCK_SIZE;
+    super.file_count = file_count;
+    super.total_blocks = total_blocks;
+    super.meta_size = file_count * sizeof(crofs_dirent_t) + (total_blocks + 1) * sizeof(uint32_t);
+
+    uint32_t *offsets = malloc((total_blocks + 1) * sizeof(uint32_t));
+    uint32_t pos = SECTOR_SIZE + super.meta_size;
+    for (uint32_t b = 0; b < total_blocks; b++) {
+        offsets[b] = pos;
+        pos += blocks[b].len;
+    }
+    offsets[total_blocks] = pos;
+    super.image_size = pos;
+
+    FILE *out = fopen(argv[1], "wb");
+    if (!out) {
+        fprintf(stderr, "mkcrofs: cannot create %s\n", argv[1]);
+        return 1;
+    }
+
+    uint8_t sector[SECTOR_SIZE];
+    memset(sector, 0, sizeof(sector));
+    memcpy(sector, &super, sizeof(super));
+    fwrite(sector, 1, sizeof(sector), out);
+    fwrite(dir, sizeof(crofs_dirent_t), file_count, out);
+    fwrite(offsets, sizeof(uint32_t), total_blocks + 1, out);
+    for (uint32_t b = 0; b < total_blocks; b++) {
+        fwrite(blocks[b].data, 1, blocks[b].len, out);
+    }
+
+    /* Pad to whole sectors for the disk driver */
+    memset(sector, 0, sizeof(sector));
+    if (pos % SECTOR_SIZE) {
+        fwrite(sector, 1, SECTOR_SIZE - pos % SECTOR_SIZE, out);
+    }
+    fclose(out);
+
+    printf("%s: %u files, %u -> %u bytes\n", argv[1], file_count, raw_total, pos);
+    return 0;
+}
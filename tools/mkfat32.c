@@ -0,0 +1,302 @@
+/*
+ * mkfat32 - build the FAT32 hard disk image on the host.
+ *
+ * usage: mkfat32 [-s size_mb] [-m manifest] <image> [NAME=]<file>...
+ *
+ * Files are written in argument order, both in the root directory and on
+ * disk, each in one contiguous run of clusters. List the hottest files
+ * (the shell) first: directory lookups then stop in the first sector and
+ * the cluster chains walk consecutive FAT entries. The manifest records
+ * where every file landed.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SECTOR_SIZE       512
+#define RESERVED_SECTORS  32
+#define NUM_FATS          2
+#define ROOT_CLUSTER      2
+#define FSINFO_SECTOR     1
+#define BACKUP_BOOT       6
+#define ATTR_ARCHIVE      0x20
+#define CLUSTER_EOC       0x0FFFFFFF
+
+/* Same layout as fat32_bpb_t in kernel/fat32.h */
+typedef struct {
+    uint8_t  jump[3];
+    uint8_t  oem_name[8];
+    uint16_t bytes_per_sector;
+    uint8_t  sectors_per_cluster;
+    uint16_t reserved_sectors;
+    uint8_t  num_fats;
+    uint16_t root_entry_count;
+    uint16_t total_sectors_16;
+    uint8_t  media_type;
+    uint16_t fat_size_16;
+    uint16_t sectors_per_track;
+    uint16_t num_heads;
+    uint32_t hidden_sectors;
+    uint32_t total_sectors_32;
+    uint32_t fat_size_32;
+    uint16_t ext_flags;
+    uint16_t fs_version;
+    uint32_t root_cluster;
+    uint16_t fs_info;
+    uint16_t backup_boot_sector;
+    uint8_t  reserved[12];
+    uint8_t  drive_number;
+    uint8_t  reserved1;
+    uint8_t  boot_signature;
+    uint32_t volume_id;
+    uint8_t  volume_label[11];
+    uint8_t  fs_type[8];
+} __attribute__((packed)) bpb_t;
+
+typedef struct {
+    uint8_t  name[11];
+    uint8_t  attr;
+    uint8_t  nt_reserved;
+    uint8_t  create_time_tenth;
+    uint16_t create_time;
+    uint16_t create_date;
+    uint16_t access_date;
+    uint16_t first_cluster_high;
+    uint16_t modify_time;
+    uint16_t modify_date;
+    uint16_t first_cluster_low;
+    uint32_t file_size;
+} __attribute__((packed)) direntry_t;
+
+typedef struct {
+    char display[13];
+    uint8_t name[11];
+    const char *path;
+    uint8_t *data;
+    uint32_t size;
+    uint32_t first_cluster;
+    uint32_t clusters;
+} entry_t;
+
+/* NAME=path or path; the name is upper-cased and must be valid 8.3 */
+static int parse_name(const char *arg, entry_t *e) {
+    const char *eq = strchr(arg, '=');
+    const char *src;
+    size_t len;
+
+    if (eq) {
+        src = arg;
+        len = eq - arg;
+        e->path = eq + 1;
+    } else {
+        const char *slash = strrchr(arg, '/');
+        src = slash ? slash + 1 : arg;
+        len = strlen(src);
+        e->path = arg;
+    }
+    if (len == 0 || len > 12) return -1;
+
+    memset(e->name, ' ', 11);
+    size_t base = 0, ext = 0;
+    int in_ext = 0;
+    for (size_t i = 0; i < len; i++) {
+        char ch = src[i];
+        if (ch >= 'a' && ch <= 'z') ch -= 32;
+        e->display[i] = ch;
+        if (ch == '.') {
+            if (in_ext || base == 0) return -1;
+            in_ext = 1;
+        } else if (in_ext) {
+            if (ext == 3) return -1;
+            e->name[8 + ext++] = (uint8_t)ch;
+        } else {
+            if (base == 8) return -1;
+            e->name[base++] = (uint8_t)ch;
+        }
+    }
+    e->display[len] = '\0';
+    return 0;
+}
+
+static uint8_t *read_file(const char *path, uint32_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(len ? len : 1);
+    if (buf && fread(buf, 1, len, f) != (size_t)len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *size = (uint32_t)len;
+    return buf;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    memcpy(p, &v, 4);
+}
+
+int main(int argc, char **argv) {
+    uint32_t size_mb = 10;
+    const char *manifest = NULL;
+    int arg = 1;
+
+    while (arg < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc) {
+            size_mb = (uint32_t)atoi(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc) {
+            manifest = argv[arg + 1];
+        } else {
+            break;
+        }
+        arg += 2;
+    }
+    if (argc - arg < 1 || size_mb == 0) {
+        fprintf(stderr, "usage: %s [-s size_mb] [-m manifest] <image> [NAME=]<file>...\n", argv[0]);
+        return 1;
+    }
+
+    const char *image = argv[arg++];
+    uint32_t count = argc - arg;
+    entry_t *files = calloc(count ? count : 1, sizeof(entry_t));
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (parse_name(argv[arg + i], &files[i]) != 0) {
+            fprintf(stderr, "mkfat32: %s is not a valid 8.3 name\n", argv[arg + i]);
+            return 1;
+        }
+        for (uint32_t j = 0; j < i; j++) {
+            if (memcmp(files[j].name, files[i].name, 11) == 0) {
+                fprintf(stderr, "mkfat32: duplicate name %s\n", files[i].display);
+                return 1;
+            }
+        }
+        files[i].data = read_file(files[i].path, &files[i].size);
+        if (!files[i].data) {
+            fprintf(stderr, "mkfat32: cannot read %s\n", files[i].path);
+            return 1;
+        }
+    }
+
+    /* Geometry: one sector per cluster, FAT sized to cover the data area */
+    uint32_t total_sectors = size_mb * 2048;
+    uint32_t fat_size = 1;
+    uint32_t cluster_count;
+    for (;;) {
+        cluster_count = total_sectors - RESERVED_SECTORS - NUM_FATS * fat_size;
+        uint32_t need = ((cluster_count + 2) * 4 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        if (need <= fat_size) break;
+        fat_size = need;
+    }
+    uint32_t data_start = RESERVED_SECTORS + NUM_FATS * fat_size;
+
+    /* Root directory first (plus an end marker), then each file in order */
+    uint32_t dir_clusters = ((count + 1) * sizeof(direntry_t) + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    uint32_t next = ROOT_CLUSTER + dir_clusters;
+    for (uint32_t i = 0; i < count; i++) {
+        files[i].clusters = (files[i].size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        files[i].first_cluster = files[i].clusters ? next : 0;
+        next += files[i].clusters;
+    }
+    if (next - 2 > cluster_count) {
+        fprintf(stderr, "mkfat32: files do not fit in %u MB\n", size_mb);
+        return 1;
+    }
+
+    uint8_t *img = calloc(total_sectors, SECTOR_SIZE);
+
+    /* Boot sector and its backup */
+    bpb_t *bpb = (bpb_t *)img;
+    memcpy(bpb->jump, "\xEB\x58\x90", 3);
+    memcpy(bpb->oem_name, "MAGNOS  ", 8);
+    bpb->bytes_per_sector = SECTOR_SIZE;
+    bpb->sectors_per_cluster = 1;
+    bpb->reserved_sectors = RESERVED_SECTORS;
+    bpb->num_fats = NUM_FATS;
+    bpb->media_type = 0xF8;
+    bpb->sectors_per_track = 32;
+    bpb->num_heads = 64;
+    bpb->total_sectors_32 = total_sectors;
+    bpb->fat_size_32 = fat_size;
+    bpb->root_cluster = ROOT_CLUSTER;
+    bpb->fs_info = FSINFO_SECTOR;
+    bpb->backup_boot_sector = BACKUP_BOOT;
+    bpb->drive_number = 0x80;
+    bpb->boot_signature = 0x29;
+    bpb->volume_id = 0x4D41474E;
+    memcpy(bpb->volume_label, "MAGNOS     ", 11);
+    memcpy(bpb->fs_type, "FAT32   ", 8);
+    img[510] = 0x55;
+    img[511] = 0xAA;
+
+    uint8_t *info = img + FSINFO_SECTOR * SECTOR_SIZE;
+    put32(info, 0x41615252);
+    put32(info + 484, 0x61417272);
+    put32(info + 488, cluster_count - (next - 2));
+    put32(info + 492, next);
+    put32(info + 508, 0xAA550000);
+
+    memcpy(img + BACKUP_BOOT * SECTOR_SIZE, img, 2 * SECTOR_SIZE);
+
+    /* FAT: reserved entries, then one straight chain per run */
+    uint32_t *fat = (uint32_t *)(img + RESERVED_SECTORS * SECTOR_SIZE);
+    fat[0] = 0x0FFFFF00 | bpb->media_type;
+    fat[1] = CLUSTER_EOC;
+    for (uint32_t c = 0; c < dir_clusters; c++) {
+        fat[ROOT_CLUSTER + c] = c + 1 < dir_clusters ? ROOT_CLUSTER + c + 1 : CLUSTER_EOC;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        for (uint32_t c = 0; c < files[i].clusters; c++) {
+            uint32_t cl = files[i].first_cluster + c;
+            fat[cl] = c + 1 < files[i].clusters ? cl + 1 : CLUSTER_EOC;
+        }
+    }
+    for (uint32_t f = 1; f < NUM_FATS; f++) {
+        memcpy(img + (RESERVED_SECTORS + f * fat_size) * SECTOR_SIZE, fat, fat_size * SECTOR_SIZE);
+    }
+
+    /* Root directory and file data */
+    direntry_t *dir = (direntry_t *)(img + data_start * SECTOR_SIZE);
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(dir[i].name, files[i].name, 11);
+        dir[i].attr = ATTR_ARCHIVE;
+        dir[i].first_cluster_high = (uint16_t)(files[i].first_cluster >> 16);
+        dir[i].first_cluster_low = (uint16_t)files[i].first_cluster;
+        dir[i].file_size = files[i].size;
+        if (files[i].size) {
+            memcpy(img + (data_start + files[i].first_cluster - 2) * SECTOR_SIZE,
+                   files[i].data, files[i].size);
+        }
+    }
+
+    FILE *out = fopen(image, "wb");
+    if (!out || fwrite(img, SECTOR_SIZE, total_sectors, out) != total_sectors) {
+        fprintf(stderr, "mkfat32: cannot write %s\n", image);
+        return 1;
+    }
+    fclose(out);
+
+    FILE *man = manifest ? fopen(manifest, "w") : NULL;
+    if (manifest && !man) {
+        fprintf(stderr, "mkfat32: cannot write %s\n", manifest);
+        return 1;
+    }
+    if (man) {
+        fprintf(man, "# %s: %u MB, data at LBA %u, root dir %u cluster(s)\n",
+                image, size_mb, data_start, dir_clusters);
+        fprintf(man, "# %-12s %8s %8s %8s %8s\n", "name", "bytes", "cluster", "count", "lba");
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t lba = files[i].clusters ? data_start + files[i].first_cluster - 2 : 0;
+            fprintf(man, "  %-12s %8u %8u %8u %8u\n", files[i].display, files[i].size,
+                    files[i].first_cluster, files[i].clusters, lba);
+        }
+        fclose(man);
+    }
+
+    printf("%s: %u files in %u contiguous clusters\n", image, count, next - ROOT_CLUSTER);
+    return 0;
+}
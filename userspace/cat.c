@@ -1,10 +1,12 @@
 #include "libmagnos.h"
 
+#define CHUNK 4096      /* One page cache page per read */
+
 int main(void) {
-    unsigned char buffer[1024];
+    unsigned char *buffer;
     char filename[64];
     int argc;
-    int result;
+    int fd;
     int bytes_read;
 
     /* Get argument count */
@@ -23,21 +25,32 @@ int main(void) {
     }
 
     /* Open the file */
-    result = file_open(filename);
-    if (result != 0) {
+    fd = file_open(filename);
+    if (fd < 0) {
         print("cat: ");
         print(filename);
         print(": No such file\n");
         return 1;
     }
 
+    /* Off the 4KB stack: the heap holds a whole page and its terminator */
+    buffer = (unsigned char *)sbrk(CHUNK + 1);
+    if (buffer == (unsigned char *)-1) {
+        print("cat: out of memory\n");
+        file_close(fd);
+        return 1;
+    }
+
+    /* Whole file, front to back: ask for full readahead up front */
+    fadvise(fd, 0, 0, FADV_SEQUENTIAL);
+
     /* Read and print file contents */
     while (1) {
-        bytes_read = file_read(buffer, sizeof(buffer) - 1);
+        bytes_read = file_read(fd, buffer, CHUNK);
 
         if (bytes_read < 0) {
             print("cat: Error reading file\n");
-            file_close();
+            file_close(fd);
             return 1;
         }
 
@@ -52,7 +65,7 @@ int main(void) {
     }
 
     /* Close the file */
-    file_close();
+    file_close(fd);
 
     return 0;
 }
@@ -1,32 +1,12 @@
 #include "libmagnos.h"
 
-static void uint_to_str(unsigned int val, char *buf) {
-    char tmp[12];
-    int i = 0;
-
-    if (val == 0) {
-        buf[0] = '0';
-        buf[1] = '\0';
-        return;
-    }
-
-    while (val > 0) {
-        tmp[i++] = '0' + (val % 10);
-        val /= 10;
-    }
-
-    int j = 0;
-    while (i > 0) {
-        buf[j++] = tmp[--i];
-    }
-    buf[j] = '\0';
-}
-
 int main(void) {
     unsigned int free_pages = meminfo(0);
     unsigned int total_pages = meminfo(1);
     unsigned int page_size = meminfo(2);
-    unsigned int used_pages = total_pages - free_pages;
+    unsigned int cached_pages = meminfo(3);
+    unsigned int tmpfs_pages = meminfo(4);
+    unsigned int used_pages = meminfo(5);
 
     unsigned int total_kb = total_pages * (page_size / 1024);
     unsigned int free_kb = free_pages * (page_size / 1024);
@@ -50,6 +30,16 @@ int main(void) {
     print(buf);
     print(" KB\n");
 
+    print("  Cache: ");
+    uint_to_str(cached_pages * (page_size / 1024), buf);
+    print(buf);
+    print(" KB\n");
+
+    print("  Tmpfs: ");
+    uint_to_str(tmpfs_pages * (page_size / 1024), buf);
+    print(buf);
+    print(" KB\n");
+
     print("  Pages: ");
     uint_to_str(free_pages, buf);
     print(buf);
@@ -79,9 +69,37 @@ int main(void) {
     print(buf);
     print(" KB\n");
 
-    /* Total available = PMM free pages (excl. heap pages) + heap free bytes */
+    /* Exec image cache */
+    unsigned int exec_hits = exec_stats(0);
+    unsigned int exec_lookups = exec_hits + exec_stats(1);
+
+    print("\nExec cache:\n");
+    print("  Images: ");
+    uint_to_str(exec_stats(2), buf);
+    print(buf);
+    print(" (");
+    uint_to_str(exec_stats(4) / 1024, buf);
+    print(buf);
+    print(" KB)\n");
+
+    print("  Hits:   ");
+    uint_to_str(exec_hits, buf);
+    print(buf);
+    print("/");
+    uint_to_str(exec_lookups, buf);
+    print(buf);
+    if (exec_lookups) {
+        print(" (");
+        uint_to_str(exec_hits * 100 / exec_lookups, buf);
+        print(buf);
+        print("%)");
+    }
+    print("\n");
+
+    /* Total available = PMM free pages (excl. heap pages) + heap free bytes
+     * + page cache (reclaimed on demand) */
     unsigned int heap_pages_used = heap_total / page_size;
-    unsigned int avail_kb = (free_pages + heap_pages_used) * (page_size / 1024);
+    unsigned int avail_kb = (free_pages + heap_pages_used + cached_pages) * (page_size / 1024);
     print("\nTotal available: ");
     uint_to_str(avail_kb, buf);
     print(buf);
@@ -0,0 +1,75 @@
+/* libmagnos routines that are too big to inline in every caller. Linked
+ * into each program, or built as the resident libmagnos.so (USER_SHARED=1). */
+
+#include "libmagnos.h"
+
+unsigned int strlen(const char *str) {
+    unsigned int len = 0;
+    while (str[len]) len++;
+    return len;
+}
+
+int strcmp(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
+int strncmp(const char *a, const char *b, unsigned int n) {
+    while (n && *a && *a == *b) {
+        a++;
+        b++;
+        n--;
+    }
+    if (n == 0) return 0;
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
+void *memcpy(void *dest, const void *src, unsigned int n) {
+    unsigned char *d = (unsigned char *)dest;
+    const unsigned char *s = (const unsigned char *)src;
+    while (n--) *d++ = *s++;
+    return dest;
+}
+
+void *memset(void *dest, int c, unsigned int n) {
+    unsigned char *d = (unsigned char *)dest;
+    while (n--) *d++ = (unsigned char)c;
+    return dest;
+}
+
+void uint_to_str(unsigned int val, char *buf) {
+    char tmp[12];
+    int i = 0;
+
+    if (val == 0) {
+        buf[0] = '0';
+        buf[1] = '\0';
+        return;
+    }
+
+    while (val > 0) {
+        tmp[i++] = '0' + (val % 10);
+        val /= 10;
+    }
+
+    int j = 0;
+    while (i > 0) {
+        buf[j++] = tmp[--i];
+    }
+    buf[j] = '\0';
+}
+
+void print_int(int n) {
+    char buf[12];
+
+    if (n < 0) {
+        print("-");
+        uint_to_str(-(unsigned int)n, buf);
+    } else {
+        uint_to_str((unsigned int)n, buf);
+    }
+    print(buf);
+}
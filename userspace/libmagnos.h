@@ -17,6 +17,75 @@
 #define SYSCALL_MEMINFO    13
 #define SYSCALL_HEAP_STATS 14
 #define SYSCALL_GETPID     15
+#define SYSCALL_FADVISE    16
+#define SYSCALL_AIO_SETUP  17
+#define SYSCALL_AIO_ENTER  18
+#define SYSCALL_FILE_WRITE 19
+#define SYSCALL_UNLINK     20
+#define SYSCALL_EXEC_STATS 21
+#define SYSCALL_FORK       22
+#define SYSCALL_SPAWN      23
+#define SYSCALL_WAITPID    24
+#define SYSCALL_BRK        25
+#define SYSCALL_MMAP       26
+#define SYSCALL_MUNMAP     27
+
+/* waitpid options */
+#define WNOHANG            1
+
+/* file_open() flags (only honoured under /tmp) */
+#define O_CREAT            0x01
+#define O_TRUNC            0x02
+
+/* Access pattern hints for fadvise() */
+#define FADV_NORMAL        0
+#define FADV_RANDOM        1
+#define FADV_SEQUENTIAL    2
+#define FADV_WILLNEED      3
+#define FADV_DONTNEED      4
+
+/* Async I/O ring (must match kernel/aio.h) */
+#define AIO_RING_ENTRIES   32
+
+#define AIO_OP_NOP         0
+#define AIO_OP_OPEN        1
+#define AIO_OP_READ        2
+#define AIO_OP_WRITE       3
+#define AIO_OP_CLOSE       4
+
+typedef struct {
+    unsigned int opcode;
+    int fd;
+    unsigned int addr;
+    unsigned int len;
+    unsigned int user_data;
+} aio_sqe_t;
+
+typedef struct {
+    unsigned int user_data;
+    int result;
+} aio_cqe_t;
+
+typedef struct {
+    volatile unsigned int sq_head;
+    volatile unsigned int sq_tail;
+    volatile unsigned int cq_head;
+    volatile unsigned int cq_tail;
+    aio_sqe_t sq[AIO_RING_ENTRIES];
+    aio_cqe_t cq[AIO_RING_ENTRIES];
+} aio_ring_t;
+
+/* malloc_mode() modes */
+#define MALLOC_BINS        0    /* Size-class bins, freed blocks reused (default) */
+#define MALLOC_BUMP        1    /* Bump allocation, free never reuses small blocks */
+
+typedef struct {
+    unsigned int in_use;        /* Bytes requested by live allocations */
+    unsigned int blocks;        /* Live allocations */
+    unsigned int held;          /* Bytes of blocks not back in a bin or unmapped */
+    unsigned int cached;        /* Bytes of freed blocks waiting in the bins */
+    unsigned int heap;          /* Bytes obtained from sbrk and mmap */
+} malloc_stats_t;
 
 /* Directory entry structure (must match kernel definition) */
 typedef struct {
@@ -36,6 +105,17 @@ static inline unsigned int __syscall(unsigned int num, unsigned int a1,
     return ret;
 }
 
+/* Four-argument syscall (fourth argument in ESI) */
+static inline unsigned int __syscall4(unsigned int num, unsigned int a1, unsigned int a2,
+                                      unsigned int a3, unsigned int a4) {
+    unsigned int ret;
+    __asm__ volatile("int $0x80"
+        : "=a"(ret)
+        : "a"(num), "b"(a1), "c"(a2), "d"(a3), "S"(a4)
+        : "memory");
+    return ret;
+}
+
 static inline int print(const char *str) {
     return (int)__syscall(SYSCALL_PRINT, (unsigned int)str, 0, 0);
 }
@@ -44,22 +124,46 @@ static inline void exit(int code) {
     __syscall(SYSCALL_EXIT, (unsigned int)code, 0, 0);
 }
 
+/* Returns a file descriptor, or -1 */
 static inline int file_open(const char *filename) {
     return (int)__syscall(SYSCALL_FILE_OPEN, (unsigned int)filename, 0, 0);
 }
 
-static inline int file_read(unsigned char *buffer, unsigned int size) {
-    return (int)__syscall(SYSCALL_FILE_READ, (unsigned int)buffer, size, 0);
+/* Create (or truncate) a file under /tmp and open it for writing */
+static inline int file_create(const char *filename) {
+    return (int)__syscall(SYSCALL_FILE_OPEN, (unsigned int)filename, O_CREAT | O_TRUNC, 0);
+}
+
+/* Returns bytes written, or -1 */
+static inline int file_write(int fd, const unsigned char *buffer, unsigned int size) {
+    return (int)__syscall(SYSCALL_FILE_WRITE, (unsigned int)fd, (unsigned int)buffer, size);
+}
+
+static inline int unlink(const char *path) {
+    return (int)__syscall(SYSCALL_UNLINK, (unsigned int)path, 0, 0);
+}
+
+static inline int file_read(int fd, unsigned char *buffer, unsigned int size) {
+    return (int)__syscall(SYSCALL_FILE_READ, (unsigned int)fd, (unsigned int)buffer, size);
+}
+
+static inline int file_close(int fd) {
+    return (int)__syscall(SYSCALL_FILE_CLOSE, (unsigned int)fd, 0, 0);
 }
 
-static inline int file_close(void) {
-    return (int)__syscall(SYSCALL_FILE_CLOSE, 0, 0, 0);
+/* Hint how bytes [offset, offset + len) of fd will be read (len 0 = to EOF) */
+static inline int fadvise(int fd, unsigned int offset, unsigned int len, int advice) {
+    return (int)__syscall4(SYSCALL_FADVISE, (unsigned int)fd, offset, len, (unsigned int)advice);
 }
 
 static inline int list_dir(dirinfo_t *entries, unsigned int max_entries) {
     return (int)__syscall(SYSCALL_LIST_DIR, (unsigned int)entries, max_entries, 0);
 }
 
+static inline int list_dir_path(const char *path, dirinfo_t *entries, unsigned int max_entries) {
+    return (int)__syscall(SYSCALL_LIST_DIR, (unsigned int)entries, max_entries, (unsigned int)path);
+}
+
 static inline int get_argc(void) {
     return (int)__syscall(SYSCALL_GET_ARGS, (unsigned int)-1, 0, 0);
 }
@@ -88,6 +192,11 @@ static inline unsigned int heap_stats(unsigned int info_type) {
     return __syscall(SYSCALL_HEAP_STATS, info_type, 0, 0);
 }
 
+/* Exec image cache: 0=hits, 1=misses, 2=images, 3=pages, 4=bytes */
+static inline unsigned int exec_stats(unsigned int info_type) {
+    return __syscall(SYSCALL_EXEC_STATS, info_type, 0, 0);
+}
+
 static inline void sleep(unsigned int ms) {
     __syscall(SYSCALL_SLEEP, ms, 0, 0);
 }
@@ -96,8 +205,106 @@ static inline unsigned int getpid(void) {
     return __syscall(SYSCALL_GETPID, 0, 0, 0);
 }
 
+/* Returns the child's pid in the parent, 0 in the child, -1 on failure */
+static inline int fork(void) {
+    return (int)__syscall(SYSCALL_FORK, 0, 0, 0);
+}
+
+/* Start a program in the background; returns its pid or a negative error */
+static inline int spawn(const char *cmdline) {
+    return (int)__syscall(SYSCALL_SPAWN, (unsigned int)cmdline, 0, 0);
+}
+
+/* Collect an exited child (pid, or -1 for any) and its exit code.
+ * Returns its pid, 0 if WNOHANG and it is still running, -1 if no child. */
+static inline int waitpid(int pid, int *status, int options) {
+    return (int)__syscall(SYSCALL_WAITPID, (unsigned int)pid, (unsigned int)status,
+                          (unsigned int)options);
+}
+
+/* Set the program break; returns 0, or -1 if the memory is not available */
+static inline int brk(void *addr) {
+    return __syscall(SYSCALL_BRK, (unsigned int)addr, 0, 0) == (unsigned int)addr ? 0 : -1;
+}
+
+/* Move the program break by increment bytes; returns the old break, or
+ * (void *)-1 if the heap cannot grow. New heap memory reads as zero. */
+static inline void *sbrk(int increment) {
+    unsigned int old = __syscall(SYSCALL_BRK, 0, 0, 0);
+    if (increment != 0 &&
+        __syscall(SYSCALL_BRK, old + increment, 0, 0) != old + increment) {
+        return (void *)-1;
+    }
+    return (void *)old;
+}
+
+/* Anonymous zero-filled memory (whole pages); returns NULL if none is free */
+static inline void *mmap(unsigned int length) {
+    return (void *)__syscall(SYSCALL_MMAP, length, 0, 0);
+}
+
+/* Release pages from mmap; addr must be page-aligned */
+static inline int munmap(void *addr, unsigned int length) {
+    return (int)__syscall(SYSCALL_MUNMAP, (unsigned int)addr, length, 0);
+}
+
 static inline unsigned int uptime(void) {
     return __syscall(SYSCALL_UPTIME, 0, 0, 0);
 }
 
+/* Register an async I/O ring (NULL unregisters) */
+static inline int aio_setup(aio_ring_t *ring) {
+    return (int)__syscall(SYSCALL_AIO_SETUP, (unsigned int)ring, 0, 0);
+}
+
+/* Hand queued SQEs to the kernel and wait for min_complete completions */
+static inline int aio_enter(unsigned int to_submit, unsigned int min_complete) {
+    return (int)__syscall(SYSCALL_AIO_ENTER, to_submit, min_complete, 0);
+}
+
+/* Library routines (libmagnos.c) */
+unsigned int strlen(const char *str);
+int strcmp(const char *a, const char *b);
+int strncmp(const char *a, const char *b, unsigned int n);
+void *memcpy(void *dest, const void *src, unsigned int n);
+void *memset(void *dest, int c, unsigned int n);
+void uint_to_str(unsigned int val, char *buf);   /* buf holds at least 11 bytes */
+void print_int(int n);
+
+/* Memory allocator (malloc.c) */
+void *malloc(unsigned int size);
+void free(void *ptr);
+void *calloc(unsigned int count, unsigned int size);
+void *realloc(void *ptr, unsigned int size);
+void malloc_mode(int mode);
+void malloc_get_stats(malloc_stats_t *stats);
+
+/* Queue one request (no trap); returns -1 if the SQ is full */
+static inline int aio_queue(aio_ring_t *ring, unsigned int opcode, int fd,
+                            const void *addr, unsigned int len, unsigned int user_data) {
+    if (ring->sq_tail - ring->sq_head >= AIO_RING_ENTRIES) {
+        return -1;
+    }
+    aio_sqe_t *sqe = &ring->sq[ring->sq_tail & (AIO_RING_ENTRIES - 1)];
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (unsigned int)addr;
+    sqe->len = len;
+    sqe->user_data = user_data;
+    __asm__ volatile("" ::: "memory");
+    ring->sq_tail++;
+    return 0;
+}
+
+/* Pop one completion if available (no trap); returns 0 if the CQ is empty */
+static inline int aio_reap(aio_ring_t *ring, aio_cqe_t *cqe) {
+    if (ring->cq_head == ring->cq_tail) {
+        return 0;
+    }
+    *cqe = ring->cq[ring->cq_head & (AIO_RING_ENTRIES - 1)];
+    __asm__ volatile("" ::: "memory");
+    ring->cq_head++;
+    return 1;
+}
+
 #endif /* LIBMAGNOS_H */
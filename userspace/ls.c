@@ -1,33 +1,8 @@
 #include "libmagnos.h"
 
-/* Helper function to convert number to string */
-static void uint_to_str(unsigned int num, char *buf) {
-    if (num == 0) {
-        buf[0] = '0';
-        buf[1] = '\0';
-        return;
-    }
-
-    char temp[12];
-    int i = 0;
-
-    while (num > 0) {
-        temp[i++] = '0' + (num % 10);
-        num /= 10;
-    }
-
-    /* Reverse */
-    int j = 0;
-    while (i > 0) {
-        buf[j++] = temp[--i];
-    }
-    buf[j] = '\0';
-}
-
 /* Helper function to pad string with spaces */
 static void print_padded(const char *str, int width) {
-    int len = 0;
-    while (str[len]) len++;
+    int len = (int)strlen(str);
 
     print(str);
 
@@ -39,15 +14,22 @@ static void print_padded(const char *str, int width) {
 int main(void) {
     dirinfo_t entries[64];  /* Buffer for up to 64 directory entries */
     char size_buf[12];
+    char path[64];
     int count;
 
+    /* Optional directory argument (e.g. "ls /tmp") */
+    path[0] = '\0';
+    if (get_argc() >= 1 && get_arg(0, path, sizeof(path)) != 0) {
+        path[0] = '\0';
+    }
+
     print("Directory listing:\n");
     print("--------------------------------------------------\n");
     print("Name            Type    Size\n");
     print("--------------------------------------------------\n");
 
     /* Get directory listing */
-    count = list_dir(entries, 64);
+    count = path[0] ? list_dir_path(path, entries, 64) : list_dir(entries, 64);
 
     if (count < 0) {
         print("Error: Failed to read directory\n");
@@ -0,0 +1,239 @@
+/*
+ * libmagnos memory allocator.
+ *
+ * Small requests (up to SMALL_MAX bytes) are rounded to one of NUM_CLASSES
+ * size classes. Each class keeps a LIFO list of freed blocks, so a free
+ * followed by a malloc of the same class is a pointer swap. Blocks are
+ * carved from an arena that grows through sbrk. Large requests get their
+ * own pages from mmap and go back with munmap on free.
+ *
+ * In MALLOC_BUMP mode small requests are carved at their exact (aligned)
+ * size and free does not reuse them: the fastest mode, for short-lived
+ * tools that exit before memory runs short.
+ *
+ * Every block starts with an 8-byte header holding the requested size
+ * and its kind, so free and realloc need no lookup.
+ */
+
+#include "libmagnos.h"
+
+#define ALIGN         8
+#define HEADER_SIZE   8
+#define PAGE_SIZE     4096
+#define NUM_CLASSES   16
+#define SMALL_MAX     2048
+#define ARENA_GROW    (16 * PAGE_SIZE)
+
+#define TAG_MAGIC     0x4D410000    /* "MA" in the high half */
+#define TAG_BUMP      0xFE
+#define TAG_LARGE     0xFF
+
+#define ROUND_UP(n, a) (((n) + (a) - 1) & ~((a) - 1))
+
+typedef struct {
+    unsigned int size;              /* Bytes requested */
+    unsigned int tag;               /* TAG_MAGIC | class, TAG_BUMP or TAG_LARGE */
+} block_header_t;
+
+/* Payload sizes of the classes */
+static const unsigned short class_size[NUM_CLASSES] = {
+    8, 16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+
+/* Class of each size up to 128, in 8-byte steps */
+static const unsigned char small_class[17] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7
+};
+
+static void *bins[NUM_CLASSES];     /* Freed payloads, linked through their first word */
+static char *arena_next;
+static char *arena_end;
+static int mode = MALLOC_BINS;
+static malloc_stats_t stats;
+
+static int size_class(unsigned int size) {
+    if (size <= 128) {
+        return small_class[(size + 7) >> 3];
+    }
+    int c = 8;
+    while (class_size[c] < size) {
+        c++;
+    }
+    return c;
+}
+
+/* Carve bytes (a multiple of ALIGN) from the arena, growing it as needed */
+static block_header_t *arena_alloc(unsigned int bytes) {
+    if ((unsigned int)(arena_end - arena_next) < bytes) {
+        unsigned int grow = ARENA_GROW;
+        char *p = (char *)sbrk(grow);
+        if (p == (char *)-1) {
+            grow = ROUND_UP(bytes, PAGE_SIZE);
+            p = (char *)sbrk(grow);
+            if (p == (char *)-1) {
+                return 0;
+            }
+        }
+        /* Someone else moved the break: the old tail cannot be extended */
+        if (p != arena_end) {
+            arena_next = p;
+        }
+        arena_end = p + grow;
+        stats.heap += grow;
+    }
+
+    block_header_t *h = (block_header_t *)arena_next;
+    arena_next += bytes;
+    return h;
+}
+
+static void *large_alloc(unsigned int size) {
+    if (size > 0xFFFFFFFF - HEADER_SIZE - PAGE_SIZE) {
+        return 0;
+    }
+    unsigned int len = ROUND_UP(size + HEADER_SIZE, PAGE_SIZE);
+    block_header_t *h = (block_header_t *)mmap(len);
+    if (!h) {
+        return 0;
+    }
+    h->size = size;
+    h->tag = TAG_MAGIC | TAG_LARGE;
+    stats.heap += len;
+    stats.held += len;
+    stats.in_use += size;
+    stats.blocks++;
+    return h + 1;
+}
+
+void *malloc(unsigned int size) {
+    if (size > SMALL_MAX) {
+        return large_alloc(size);
+    }
+
+    block_header_t *h;
+    unsigned int bytes;
+
+    if (mode == MALLOC_BUMP) {
+        bytes = HEADER_SIZE + ROUND_UP(size, ALIGN);
+        h = arena_alloc(bytes);
+        if (!h) {
+            return 0;
+        }
+        h->tag = TAG_MAGIC | TAG_BUMP;
+    } else {
+        int c = size_class(size);
+        bytes = HEADER_SIZE + class_size[c];
+        void *p = bins[c];
+        if (p) {
+            bins[c] = *(void **)p;
+            stats.cached -= bytes;
+            h = (block_header_t *)p - 1;
+        } else {
+            h = arena_alloc(bytes);
+            if (!h) {
+                return 0;
+            }
+            h->tag = TAG_MAGIC | c;
+        }
+    }
+
+    h->size = size;
+    stats.held += bytes;
+    stats.in_use += size;
+    stats.blocks++;
+    return h + 1;
+}
+
+/* Header of a live block, NULL for pointers malloc never returned */
+static block_header_t *header_of(void *ptr) {
+    block_header_t *h = (block_header_t *)ptr - 1;
+    return (h->tag & 0xFFFF0000) == TAG_MAGIC ? h : 0;
+}
+
+/* Bytes a block can hold without moving */
+static unsigned int capacity(block_header_t *h) {
+    unsigned int kind = h->tag & 0xFFFF;
+    if (kind == TAG_LARGE) {
+        return ROUND_UP(h->size + HEADER_SIZE, PAGE_SIZE) - HEADER_SIZE;
+    }
+    if (kind == TAG_BUMP) {
+        return ROUND_UP(h->size, ALIGN);
+    }
+    return class_size[kind];
+}
+
+void free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    block_header_t *h = header_of(ptr);
+    if (!h) {
+        return;
+    }
+
+    unsigned int kind = h->tag & 0xFFFF;
+    stats.in_use -= h->size;
+    stats.blocks--;
+
+    if (kind == TAG_LARGE) {
+        unsigned int len = capacity(h) + HEADER_SIZE;
+        h->tag = 0;
+        munmap(h, len);
+        stats.heap -= len;
+        stats.held -= len;
+    } else if (kind == TAG_BUMP) {
+        /* Not reused: the arena only moves forward */
+        h->tag = 0;
+    } else {
+        *(void **)ptr = bins[kind];
+        bins[kind] = ptr;
+        stats.held -= HEADER_SIZE + class_size[kind];
+        stats.cached += HEADER_SIZE + class_size[kind];
+    }
+}
+
+void *calloc(unsigned int count, unsigned int size) {
+    if (size && count > 0xFFFFFFFF / size) {
+        return 0;
+    }
+    void *p = malloc(count * size);
+    if (p) {
+        memset(p, 0, count * size);
+    }
+    return p;
+}
+
+void *realloc(void *ptr, unsigned int size) {
+    if (!ptr) {
+        return malloc(size);
+    }
+    block_header_t *h = header_of(ptr);
+    if (!h) {
+        return 0;
+    }
+
+    /* Shrinking or growing within the block's slack stays in place; a
+     * large block only while it still needs all of its pages */
+    if (size <= capacity(h) &&
+        ((h->tag & 0xFFFF) != TAG_LARGE ||
+         ROUND_UP(size + HEADER_SIZE, PAGE_SIZE) == capacity(h) + HEADER_SIZE)) {
+        stats.in_use += size - h->size;
+        h->size = size;
+        return ptr;
+    }
+
+    void *p = malloc(size);
+    if (p) {
+        memcpy(p, ptr, h->size < size ? h->size : size);
+        free(ptr);
+    }
+    return p;
+}
+
+void malloc_mode(int new_mode) {
+    mode = new_mode;
+}
+
+void malloc_get_stats(malloc_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,110 @@
+/*
+ * mbench - malloc microbenchmark.
+ *
+ * Runs allocation patterns modelled on the tools and reports, for each,
+ * malloc+free operations per second and how much of the memory taken
+ * from the kernel is not holding live data (fragmentation plus headers).
+ * The bump arena goes last: the memory it uses is never reused.
+ */
+
+#include "libmagnos.h"
+
+#define SLOTS       256         /* Live allocations kept by the churn patterns */
+#define CHURN_OPS   100000
+#define BUMP_OPS    20000
+
+static unsigned int seed = 12345;
+static void *slot[SLOTS];
+static unsigned int slot_size[SLOTS];
+
+static unsigned int rand(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+/* Mostly small strings and records, like the shell and ls */
+static unsigned int small_size(void) {
+    unsigned int r = rand();
+    return (r & 3) ? 8 + (r >> 2) % 57 : 64 + (r >> 2) % 193;
+}
+
+/* Buffers too: one in sixteen is several pages */
+static unsigned int mixed_size(void) {
+    unsigned int r = rand();
+    if ((r & 15) == 0) {
+        return 4096 + (r >> 4) % 12288;
+    }
+    return 8 + (r >> 4) % 2041;
+}
+
+static void report(const char *name, unsigned int ops, unsigned int ms) {
+    malloc_stats_t st;
+    malloc_get_stats(&st);
+
+    if (ms == 0) {
+        ms = 1;  /* Below the 10ms timer tick */
+    }
+    print(name);
+    print(": ");
+    print_int((int)ops);
+    print(" ops in ");
+    print_int((int)ms);
+    print(" ms, ");
+    print_int((int)(ops / ms * 1000 + ops % ms * 1000 / ms));
+    print(" ops/sec\n    live ");
+    print_int((int)st.in_use);
+    print(" bytes in ");
+    print_int((int)st.blocks);
+    print(" blocks, heap ");
+    print_int((int)st.heap);
+    print(" bytes, fragmentation ");
+    print_int(st.heap ? (int)((st.heap - st.in_use) * 100 / st.heap) : 0);
+    print("%\n");
+}
+
+/* Replace random slots; returns 0, or -1 when out of memory */
+static int churn(const char *name, unsigned int (*size_fn)(void)) {
+    unsigned int start = uptime();
+
+    for (unsigned int i = 0; i < CHURN_OPS; i++) {
+        unsigned int s = rand() % SLOTS;
+        if (slot[s]) {
+            free(slot[s]);
+            slot[s] = 0;
+            continue;
+        }
+        slot_size[s] = size_fn();
+        slot[s] = malloc(slot_size[s]);
+        if (!slot[s]) {
+            print(name);
+            print(": out of memory\n");
+            return -1;
+        }
+        ((unsigned char *)slot[s])[slot_size[s] - 1] = 1;
+    }
+
+    report(name, CHURN_OPS, uptime() - start);
+    for (unsigned int s = 0; s < SLOTS; s++) {
+        free(slot[s]);
+        slot[s] = 0;
+    }
+    return 0;
+}
+
+int main(void) {
+    if (churn("small churn", small_size) != 0 || churn("mixed churn", mixed_size) != 0) {
+        return 1;
+    }
+
+    /* Allocate and never free, as a short-lived tool would */
+    malloc_mode(MALLOC_BUMP);
+    unsigned int start = uptime();
+    for (unsigned int i = 0; i < BUMP_OPS; i++) {
+        if (!malloc(small_size())) {
+            print("bump arena: out of memory\n");
+            return 1;
+        }
+    }
+    report("bump arena", BUMP_OPS, uptime() - start);
+    return 0;
+}
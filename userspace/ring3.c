@@ -21,9 +21,9 @@ int main(void) {
     print(buf);
     print("s OK\n");
 
-    print("\nTest 3: Attempting to read kernel memory (0x1000)...\n");
+    print("\nTest 3: Attempting to read kernel memory (0xC0001000)...\n");
     print("  This should cause a page fault:\n");
-    volatile unsigned int *kernel_mem = (volatile unsigned int *)0x1000;
+    volatile unsigned int *kernel_mem = (volatile unsigned int *)0xC0001000;
     unsigned int val2 = *kernel_mem;
     (void)val2;
 
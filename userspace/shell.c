@@ -1,15 +1,5 @@
 #include "libmagnos.h"
 
-static int strncmp(const char *a, const char *b, int n) {
-    while (n && *a && *a == *b) {
-        a++;
-        b++;
-        n--;
-    }
-    if (n == 0) return 0;
-    return (unsigned char)*a - (unsigned char)*b;
-}
-
 /* Helper function to print a character */
 static void putchar_custom(char c) {
     char buf[2];
@@ -18,6 +8,28 @@ static void putchar_custom(char c) {
     print(buf);
 }
 
+static void report_done(int pid, int code) {
+    print("[");
+    print_int(pid);
+    print("] Done (");
+    print_int(code);
+    print(")\n");
+}
+
+static void report_error(int result, const char *cmd) {
+    if (result == -1) {
+        print("Command not found: ");
+        print(cmd);
+        print("\n");
+    } else if (result == -3) {
+        print("Error: Failed to read file\n");
+    } else if (result == -4) {
+        print("Error: Not an ELF binary\n");
+    } else if (result == -5) {
+        print("Error: Failed to execute\n");
+    }
+}
+
 int main(void) {
     char cmd_buf[64];
     int cmd_pos = 0;
@@ -53,22 +65,43 @@ int main(void) {
                     return 0;
                 }
 
-                /* Execute the command */
-                int result = exec(cmd_buf);
+                /* Wait for every background job */
+                if (strncmp(cmd_buf, "wait", sizeof(cmd_buf)) == 0) {
+                    int code, pid;
+                    while ((pid = waitpid(-1, &code, 0)) > 0) {
+                        report_done(pid, code);
+                    }
+                    cmd_pos = 0;
+                    print("MagnOS> ");
+                    continue;
+                }
 
-                if (result == -1) {
-                    print("Command not found: ");
-                    print(cmd_buf);
-                    print("\n");
-                } else if (result == -2) {
-                    print("Error: File too large\n");
-                } else if (result == -3) {
-                    print("Error: Failed to read file\n");
-                } else if (result == -4) {
-                    print("Error: Not an ELF binary\n");
-                } else if (result == -5) {
-                    print("Error: Failed to execute\n");
+                /* A trailing '&' runs the command in the background */
+                int background = 0;
+                while (cmd_pos > 0 && (cmd_buf[cmd_pos - 1] == ' ' || cmd_buf[cmd_pos - 1] == '&')) {
+                    if (cmd_buf[cmd_pos - 1] == '&') background = 1;
+                    cmd_buf[--cmd_pos] = '\0';
                 }
+
+                if (background) {
+                    int pid = spawn(cmd_buf);
+                    if (pid > 0) {
+                        print("[");
+                        print_int(pid);
+                        print("]\n");
+                    } else {
+                        report_error(pid, cmd_buf);
+                    }
+                } else {
+                    /* Execute the command */
+                    report_error(exec(cmd_buf), cmd_buf);
+                }
+            }
+
+            /* Report background jobs that finished meanwhile */
+            int code, pid;
+            while ((pid = waitpid(-1, &code, WNOHANG)) > 0) {
+                report_done(pid, code);
             }
 
             cmd_pos = 0;
@@ -0,0 +1,77 @@
+#include "libmagnos.h"
+
+static aio_ring_t ring;
+static unsigned char chunks[3][65];
+
+static void print_num(int n) {
+    char buf[12];
+    char tmp[12];
+    int i = 0, j = 0;
+    if (n < 0) {
+        buf[j++] = '-';
+        n = -n;
+    }
+    do {
+        tmp[i++] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    while (i > 0) buf[j++] = tmp[--i];
+    buf[j] = '\0';
+    print(buf);
+}
+
+int main(void) {
+    aio_cqe_t cqe;
+
+    print("AioTest: registering ring...\n");
+    if (aio_setup(&ring) != 0) {
+        print("AioTest: aio_setup failed\n");
+        return 1;
+    }
+
+    /* Open synchronously through the ring: submit 1, wait for 1 */
+    aio_queue(&ring, AIO_OP_OPEN, 0, "HELLO.TXT", 0, 100);
+    aio_enter(1, 1);
+    if (!aio_reap(&ring, &cqe) || cqe.user_data != 100 || cqe.result < 0) {
+        print("AioTest: open failed\n");
+        return 1;
+    }
+    int fd = cqe.result;
+
+    /* Queue three reads and submit them in one trap without waiting */
+    for (int i = 0; i < 3; i++) {
+        aio_queue(&ring, AIO_OP_READ, fd, chunks[i], 64, i);
+    }
+    print("AioTest: submitted ");
+    print_num(aio_enter(3, 0));
+    print(" reads\n");
+
+    /* Idle while the kernel works off the queue */
+    sleep(100);
+
+    /* Poll completions without a trap */
+    int done = 0;
+    while (done < 3) {
+        if (!aio_reap(&ring, &cqe)) {
+            aio_enter(0, 1);
+            continue;
+        }
+        print("  read #");
+        print_num((int)cqe.user_data);
+        print(": ");
+        print_num(cqe.result);
+        print(" bytes\n");
+        done++;
+    }
+
+    aio_queue(&ring, AIO_OP_CLOSE, fd, 0, 0, 200);
+    aio_enter(1, 1);
+    aio_reap(&ring, &cqe);
+    print("AioTest: close returned ");
+    print_num(cqe.result);
+    print("\n");
+
+    aio_setup(0);
+    print("AioTest: done\n");
+    return 0;
+}
@@ -5,17 +5,18 @@ int main(void) {
 
     /* Test 1: lowercase filename */
     print("1. Opening 'hello.txt' (lowercase)...\n");
-    if (file_open("hello.txt") == 0) {
+    int fd = file_open("hello.txt");
+    if (fd >= 0) {
         print("   SUCCESS: Opened HELLO.TXT\n");
 
         unsigned char buf[64];
-        int bytes = file_read(buf, sizeof(buf) - 1);
+        int bytes = file_read(fd, buf, sizeof(buf) - 1);
         if (bytes > 0) {
             buf[bytes] = '\0';
             print("   Content: ");
             print((char*)buf);
         }
-        file_close();
+        file_close(fd);
     } else {
         print("   FAILED\n");
     }
@@ -24,9 +25,10 @@ int main(void) {
 
     /* Test 2: uppercase filename */
     print("2. Opening 'HELLO.TXT' (uppercase)...\n");
-    if (file_open("HELLO.TXT") == 0) {
+    fd = file_open("HELLO.TXT");
+    if (fd >= 0) {
         print("   SUCCESS: Opened HELLO.TXT\n");
-        file_close();
+        file_close(fd);
     } else {
         print("   FAILED\n");
     }
@@ -35,9 +37,10 @@ int main(void) {
 
     /* Test 3: mixed case filename */
     print("3. Opening 'HeLLo.TxT' (mixed case)...\n");
-    if (file_open("HeLLo.TxT") == 0) {
+    fd = file_open("HeLLo.TxT");
+    if (fd >= 0) {
         print("   SUCCESS: Opened HELLO.TXT\n");
-        file_close();
+        file_close(fd);
     } else {
         print("   FAILED\n");
     }
@@ -2,6 +2,7 @@
 
 int main(void) {
     unsigned char buffer[512];
+    int fd;
     int result;
     int bytes_read;
     unsigned int i;
@@ -9,8 +10,8 @@ int main(void) {
     print("FileTest: Opening HELLO.TXT...\n");
 
     /* Open the file */
-    result = file_open("HELLO.TXT");
-    if (result != 0) {
+    fd = file_open("HELLO.TXT");
+    if (fd < 0) {
         print("FileTest: Failed to open file!\n");
         exit(1);
     }
@@ -19,10 +20,10 @@ int main(void) {
     print("FileTest: Reading file contents...\n\n");
 
     /* Read file contents */
-    bytes_read = file_read(buffer, sizeof(buffer) - 1);
+    bytes_read = file_read(fd, buffer, sizeof(buffer) - 1);
     if (bytes_read < 0) {
         print("FileTest: Failed to read file!\n");
-        file_close();
+        file_close(fd);
         exit(1);
     }
 
@@ -57,7 +58,7 @@ int main(void) {
     print(" bytes\n");
 
     /* Close the file */
-    result = file_close();
+    result = file_close(fd);
     if (result != 0) {
         print("FileTest: Warning - failed to close file\n");
     } else {
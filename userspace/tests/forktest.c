@@ -0,0 +1,43 @@
+#include "libmagnos.h"
+
+static int counter = 1;
+
+int main(void) {
+    char local[16] = "parent";
+
+    print("ForkTest: forking...\n");
+
+    int pid = fork();
+    if (pid < 0) {
+        print("ForkTest: fork failed!\n");
+        exit(1);
+    }
+
+    if (pid == 0) {
+        /* Writes here must stay private to the child */
+        counter = 2;
+        local[0] = 'c';
+        local[1] = 'h';
+        local[2] = 'i';
+        local[3] = 'l';
+        local[4] = 'd';
+        local[5] = '\0';
+        print("ForkTest: child says ");
+        print(local);
+        print("\n");
+        exit(0);
+    }
+
+    int code = -1;
+    if (waitpid(pid, &code, 0) != pid || code != 0) {
+        print("ForkTest: child did not exit cleanly!\n");
+        exit(1);
+    }
+    if (counter != 1 || local[0] != 'p') {
+        print("ForkTest: parent memory changed!\n");
+        exit(1);
+    }
+    print("ForkTest: parent memory intact\n");
+    exit(0);
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "libmagnos.h"
+
+#define HEAP_BYTES  (3 * 4096 + 100)
+#define MAP_BYTES   (8 * 4096)
+
+static int fail(const char *msg) {
+    print("HeapTest: ");
+    print(msg);
+    print("\n");
+    exit(1);
+    return 1;
+}
+
+int main(void) {
+    /* Heap: fresh pages read as zero and keep what is written */
+    unsigned char *heap = (unsigned char *)sbrk(HEAP_BYTES);
+    if (heap == (unsigned char *)-1) {
+        return fail("sbrk failed!");
+    }
+    for (unsigned int i = 0; i < HEAP_BYTES; i++) {
+        if (heap[i] != 0) {
+            return fail("new heap memory not zero!");
+        }
+        heap[i] = (unsigned char)i;
+    }
+    for (unsigned int i = 0; i < HEAP_BYTES; i++) {
+        if (heap[i] != (unsigned char)i) {
+            return fail("heap contents lost!");
+        }
+    }
+    if ((unsigned char *)sbrk(0) != heap + HEAP_BYTES) {
+        return fail("break in the wrong place!");
+    }
+
+    /* Anonymous mapping above the heap; the break cannot grow into it */
+    unsigned int *map = (unsigned int *)mmap(MAP_BYTES);
+    if (!map) {
+        return fail("mmap failed!");
+    }
+    for (unsigned int i = 0; i < MAP_BYTES / 4; i += 1024) {
+        map[i] = i;
+    }
+    if (brk((unsigned char *)map + 4096) == 0) {
+        return fail("break grew over a mapping!");
+    }
+
+    /* A forked child sees the same data in its own copy */
+    int pid = fork();
+    if (pid == 0) {
+        map[0] = 0xDEAD;
+        exit(heap[5] == 5 && map[1024] == 1024 ? 0 : 1);
+    }
+    int code = -1;
+    if (pid < 0 || waitpid(pid, &code, 0) != pid || code != 0 || map[0] != 0) {
+        return fail("fork did not copy the heap!");
+    }
+
+    if (munmap(map, MAP_BYTES) != 0 || munmap(heap, 4096) == 0) {
+        return fail("munmap misbehaved!");
+    }
+    if (brk(heap) != 0) {
+        return fail("could not shrink the heap!");
+    }
+
+    print("HeapTest: heap and mappings OK\n");
+    exit(0);
+    return 0;
+}
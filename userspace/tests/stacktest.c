@@ -0,0 +1,42 @@
+#include "libmagnos.h"
+
+/* Each level takes two pages of stack */
+static unsigned int deep(unsigned int depth) {
+    volatile unsigned char frame[8192];
+    frame[0] = (unsigned char)depth;
+    frame[sizeof(frame) - 1] = (unsigned char)depth;
+    if (depth == 0) {
+        return frame[0];
+    }
+    return deep(depth - 1) + frame[sizeof(frame) - 1];
+}
+
+static unsigned int forever(unsigned int depth) {
+    volatile unsigned char frame[1024];
+    frame[0] = (unsigned char)depth;
+    return forever(depth + 1) + frame[0];
+}
+
+int main(void) {
+    /* Six levels, 48KB of stack: well past the first page */
+    if (deep(5) != 15) {
+        print("StackTest: deep recursion returned the wrong value!\n");
+        exit(1);
+    }
+    print("StackTest: 48KB of stack OK\n");
+
+    /* Runaway recursion must hit the guard page and kill only the child */
+    int pid = fork();
+    if (pid == 0) {
+        forever(0);
+        exit(0);
+    }
+    int code = 0;
+    if (pid < 0 || waitpid(pid, &code, 0) != pid || code != -1) {
+        print("StackTest: runaway recursion was not stopped!\n");
+        exit(1);
+    }
+    print("StackTest: guard page stopped runaway recursion\n");
+    exit(0);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "libmagnos.h"
+
+#define CHUNK 1000
+#define CHUNKS 10
+
+int main(void) {
+    unsigned char buffer[CHUNK];
+    int fd;
+    int total = 0;
+    int n;
+
+    print("TmpTest: Creating /tmp/test.dat...\n");
+
+    fd = file_create("/tmp/test.dat");
+    if (fd < 0) {
+        print("TmpTest: Failed to create file!\n");
+        exit(1);
+    }
+
+    /* Write enough to span several pages */
+    for (int c = 0; c < CHUNKS; c++) {
+        for (int i = 0; i < CHUNK; i++) {
+            buffer[i] = (unsigned char)('a' + c);
+        }
+        if (file_write(fd, buffer, CHUNK) != CHUNK) {
+            print("TmpTest: Short write!\n");
+            file_close(fd);
+            exit(1);
+        }
+    }
+    file_close(fd);
+
+    print("TmpTest: Reading it back...\n");
+
+    fd = file_open("/tmp/test.dat");
+    if (fd < 0) {
+        print("TmpTest: Failed to reopen file!\n");
+        exit(1);
+    }
+
+    while ((n = file_read(fd, buffer, CHUNK)) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (buffer[i] != (unsigned char)('a' + (total + i) / CHUNK)) {
+                print("TmpTest: Data mismatch!\n");
+                file_close(fd);
+                exit(1);
+            }
+        }
+        total += n;
+    }
+    file_close(fd);
+
+    if (total != CHUNK * CHUNKS) {
+        print("TmpTest: Wrong file size!\n");
+        exit(1);
+    }
+
+    if (unlink("/tmp/test.dat") != 0 || file_open("/tmp/test.dat") >= 0) {
+        print("TmpTest: Unlink failed!\n");
+        exit(1);
+    }
+
+    print("TmpTest: PASSED\n");
+    return 0;
+}
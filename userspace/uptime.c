@@ -1,28 +1,5 @@
 #include "libmagnos.h"
 
-/* Simple integer to string conversion */
-static void uint_to_str(unsigned int val, char *buf) {
-    char tmp[12];
-    int i = 0;
-
-    if (val == 0) {
-        buf[0] = '0';
-        buf[1] = '\0';
-        return;
-    }
-
-    while (val > 0) {
-        tmp[i++] = '0' + (val % 10);
-        val /= 10;
-    }
-
-    int j = 0;
-    while (i > 0) {
-        buf[j++] = tmp[--i];
-    }
-    buf[j] = '\0';
-}
-
 int main(void) {
     unsigned int ms = uptime();
     unsigned int seconds = ms / 1000;